@@ -246,6 +246,7 @@ int main(int argc, char* argv[]) {
     printf("The frequencies of each word are: \n");
     fprint_words(word_counts, stdout);
   }
+  deallocate_list(word_counts);
   return 0;
 }
 
@@ -24,20 +24,41 @@ Mutators take a reference to a list as first arg.
 
 /* Basic utilities */
 
-char* new_string(char* str) {
-    return strcpy((char*) malloc(strlen(str) + 1), str);
+/*
+ * Nodes and their words are carved out of the list's arena instead of being
+ * malloc'd one at a time. Nothing is freed on its own; deallocate_list
+ * releases the whole arena at once.
+ */
+static WordCount* new_node(arena_t* arena) {
+  WordCount* wc = (WordCount *) arena_alloc(arena, sizeof(WordCount));
+
+  if (wc != NULL) {
+      wc->count = 0;
+      wc->word = NULL;
+      wc->next = NULL;
+      wc->arena = arena;
+  }
+  return wc;
+}
+
+static char* new_string(arena_t* arena, char* str) {
+    return arena_strndup(arena, str, strlen(str));
 }
 
 void init_words(WordCount** wclist) {
   /* Initialize word count. */
-  *wclist = (WordCount *) malloc(sizeof(WordCount));
-  if (*wclist == NULL) {
+  arena_t* arena = (arena_t *) malloc(sizeof(arena_t));
+
+  *wclist = NULL;
+  if (arena == NULL) {
       return;
   }
+  arena_init(arena);
 
-  (*wclist)->count = 0;
-  (*wclist)->word = NULL;
-  (*wclist)->next = NULL;
+  *wclist = new_node(arena);
+  if (*wclist == NULL) {
+      free(arena);
+  }
 }
 
 size_t len_words(WordCount* wchead) {
@@ -77,17 +98,19 @@ void add_word(WordCount** wclist, char* word) {
       if ((*wclist)->word == NULL) {
           new_word = *wclist;
       } else {
-          init_words(&new_word);
+          new_word = new_node((*wclist)->arena);
+          if (new_word == NULL) {
+              return;
+          }
           new_word->next = *wclist;
           *wclist = new_word;
       }
       /* Allocating memory for word field. */
-      new_word->word = (char *) malloc(sizeof(char) * (strlen(word) + 1));
+      new_word->word = new_string(new_word->arena, word);
       if (new_word->word == NULL) {
           return;
       }
 
-      strcpy(new_word->word, word);
       new_word->count = 1;
   } else {
       found_word->count += 1;
@@ -104,26 +127,78 @@ void fprint_words(WordCount* wchead, FILE* ofile) {
   }
 }
 
-void deallocate_word(WordCount* word) {
-    if (word == NULL) {
-        return;
-    }
-
-    if (word->word != NULL) {
-        free(word->word);
-    }
+void wordcount_insert_ordered(WordCount** wclist, WordCount* elem,
+                              bool less(const WordCount*, const WordCount*)) {
+  /* Goes after every entry it is not less than, so equal entries keep their order. */
+  WordCount** link = wclist;
 
-    free(word);
+  while (*link != NULL && !less(elem, *link)) {
+      link = &(*link)->next;
+  }
+  elem->next = *link;
+  *link = elem;
 }
 
+/*
+ * Bottom-up merge sort on the list itself: merges runs of 1, 2, 4, ...
+ * entries until one run is left, so it takes O(n log n) comparisons, no
+ * recursion and no extra memory. Ties take the entry from the earlier run,
+ * which keeps the sort stable.
+ */
+void wordcount_sort(WordCount** wclist, bool less(const WordCount*, const WordCount*)) {
+  WordCount* list = *wclist;
+  size_t run = 1, merges;
+
+  do {
+      WordCount* left = list;
+      WordCount** tail = &list;
+      merges = 0;
+
+      while (left != NULL) {
+          WordCount* right = left;
+          size_t left_len = 0, right_len = run;
+          merges++;
+
+          while (left_len < run && right != NULL) {
+              right = right->next;
+              left_len++;
+          }
+
+          while (left_len > 0 || (right_len > 0 && right != NULL)) {
+              WordCount* next;
+              if (left_len == 0) {
+                  next = right;
+                  right = right->next;
+                  right_len--;
+              } else if (right_len == 0 || right == NULL || !less(right, left)) {
+                  next = left;
+                  left = left->next;
+                  left_len--;
+              } else {
+                  next = right;
+                  right = right->next;
+                  right_len--;
+              }
+              *tail = next;
+              tail = &next->next;
+          }
+          left = right;
+      }
+      *tail = NULL;
+      run *= 2;
+  } while (merges > 1);
+
+  *wclist = list;
+}
 
 void deallocate_list(WordCount* wchead) {
-    WordCount* temp;
+    /* Every node and word came from the list's arena, so the list itself needs no walk. */
+    arena_t* arena;
 
-    while (wchead) {
-        temp = wchead;
-        wchead = wchead->next;
-
-        deallocate_word(temp);
+    if (wchead == NULL) {
+        return;
     }
+    arena = wchead->arena;
+    arena_release(arena);
+    free(arena);
 }
@@ -33,12 +33,17 @@ Mutators take a reference to a list as first arg.
 #include <string.h>
 #include <stdlib.h>
 
+#include "arena.h"
+
 /* Representation of a word count object.
-   Includes next field for constructing singly linked list*/
+   Includes next field for constructing singly linked list.
+   Every node and word of a list comes from the list's arena,
+   which each node points to. */
 struct word_count {
   char* word;
   int count;
   struct word_count* next;
+  arena_t* arena;
 };
 
 /* Introduce a type name for the struct */
@@ -68,4 +73,7 @@ void wordcount_insert_ordered(WordCount** wclist, WordCount* elem,
 /* Sort a word count list in place */
 void wordcount_sort(WordCount** wclist, bool less(const WordCount*, const WordCount*));
 
+/* Free a word count list along with every word in it, given any of its nodes */
+void deallocate_list(WordCount* wchead);
+
 #endif /* word_count_h */
@@ -0,0 +1,105 @@
+/*
+ * Implementation of the arena interface.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* Usable bytes in a block. Larger requests get a block of their own. */
+#define BLOCK_SIZE (64 * 1024 - sizeof(struct arena_block))
+
+/* Enough for any object a word count list stores. */
+#define ALIGNMENT 16
+
+struct arena_block {
+  struct arena_block* next;
+  size_t used;
+  size_t size;
+  char data[] __attribute__((aligned(ALIGNMENT)));
+};
+
+void arena_init(arena_t* arena) { arena->blocks = NULL; }
+
+void* arena_alloc(arena_t* arena, size_t size) {
+  struct arena_block* block = arena->blocks;
+  void* ptr;
+
+  size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  if (block == NULL || block->size - block->used < size) {
+    size_t block_size = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+
+    block = malloc(sizeof(struct arena_block) + block_size);
+    if (block == NULL) {
+      return NULL;
+    }
+    block->used = 0;
+    block->size = block_size;
+    if (size > BLOCK_SIZE && arena->blocks != NULL) {
+      /* Keep carving from the current block; the big one is full already. */
+      block->next = arena->blocks->next;
+      arena->blocks->next = block;
+    } else {
+      block->next = arena->blocks;
+      arena->blocks = block;
+    }
+  }
+
+  ptr = block->data + block->used;
+  block->used += size;
+  return ptr;
+}
+
+char* arena_strndup(arena_t* arena, const char* str, size_t len) {
+  char* copy = arena_alloc(arena, len + 1);
+
+  if (copy != NULL) {
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+  }
+  return copy;
+}
+
+void arena_adopt(arena_t* dst, arena_t* src) {
+  struct arena_block* last = src->blocks;
+
+  if (last == NULL) {
+    return;
+  }
+  while (last->next != NULL) {
+    last = last->next;
+  }
+  /* Put SRC's blocks behind DST's current block so DST keeps carving from it. */
+  if (dst->blocks != NULL) {
+    last->next = dst->blocks->next;
+    dst->blocks->next = src->blocks;
+  } else {
+    dst->blocks = src->blocks;
+  }
+  src->blocks = NULL;
+}
+
+void arena_release(arena_t* arena) {
+  while (arena->blocks != NULL) {
+    struct arena_block* next = arena->blocks->next;
+    free(arena->blocks);
+    arena->blocks = next;
+  }
+}
@@ -0,0 +1,50 @@
+/*
+ * The arena interface is a bump-pointer allocator. Objects are carved out of
+ * large blocks and never freed one at a time; the whole arena is released at
+ * once when its owner goes away.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+struct arena_block;
+
+/* An arena is the list of blocks it has carved from, newest first. */
+typedef struct arena {
+  struct arena_block* blocks;
+} arena_t;
+
+/* Initialize an empty arena. */
+void arena_init(arena_t* arena);
+
+/* Allocate SIZE bytes, aligned for any object. Returns NULL if memory ran out. */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/* Copy the LEN bytes at STR into the arena as a NUL-terminated string. */
+char* arena_strndup(arena_t* arena, const char* str, size_t len);
+
+/* Hand every block of SRC over to DST, leaving SRC empty. */
+void arena_adopt(arena_t* dst, arena_t* src);
+
+/* Free everything allocated from the arena, leaving it empty. */
+void arena_release(arena_t* arena);
+
+#endif /* ARENA_H */
@@ -27,65 +27,676 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <time.h>
 #include <pthread.h>
+#include <semaphore.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(WORD_TIMERS) && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 
 #include "word_count.h"
 #include "word_helpers.h"
+#include "word_scan.h"
+#include "word_rank.h"
 
 /* Global variable for the list. */
 word_count_list_t word_counts;
 
+/*
+ * Per-thread state. Each thread counts into a private table that nobody else
+ * touches until the thread posts MERGED, so counting needs no locks. Thread
+ * 0's table is word_counts, which is made private too unless --shared is on.
+ * The tables are then folded together pairwise: after counting, thread i
+ * absorbs the tables of threads i + 1, i + 2, i + 4, ... as long as i is a
+ * multiple of twice the stride, which leaves the grand total in thread 0's
+ * table after log2(n) rounds. Only thread i ever writes to its table, so the
+ * merges need no locks either.
+ */
+typedef struct counter {
+  char* path;
+  word_count_list_t* counts;
+  sem_t merged;
+} counter_t;
+
+static counter_t* counters;
+static int num_counters;
+static bool merge_failed; /* Set if a merge ran out of memory. */
+
+/*
+ * With --shared, every thread adds straight into word_counts instead of a
+ * private table, and there is nothing to merge. This is the default for the
+ * striped map, which is built for it.
+ */
+#ifdef WORD_STRIPED
+static bool share_counts = true;
+#else
+static bool share_counts = false;
+#endif
+
+/* A piece of a mapped input file, cut so that no word straddles two chunks. */
+typedef struct chunk {
+  const char* buf;
+  size_t len;
+} chunk_t;
+
+/* Work queue for -j mode. Workers claim chunks by bumping next_chunk. */
+static chunk_t* chunks;
+static size_t num_chunks;
+static size_t next_chunk;
+
+/*
+ * Phase timers. Building with -DWORD_TIMERS makes pwords report on stderr how
+ * long it spent in each phase, summed over threads. Ticks come from the time
+ * stamp counter on x86-64 and are converted to seconds against the monotonic
+ * clock over the whole run, so taking one costs a few nanoseconds and the
+ * per-word tokenize/insert split stays cheap. Without WORD_TIMERS, timer_now
+ * is a constant and the bookkeeping compiles away.
+ *
+ * Pages of a mapped file are read in as the tokenizer touches them, so with
+ * mmap most of the I/O shows up under tokenize, not read. Inputs that go
+ * through count_words are read, tokenized and inserted in one loop, all of
+ * which is charged to insert. Laps are wall-clock, so with more threads than
+ * cores the sums also include time spent waiting for a core.
+ */
+enum phase { PHASE_READ, PHASE_TOKENIZE, PHASE_INSERT, PHASE_MERGE, PHASE_SORT, PHASE_PRINT, NUM_PHASES };
+
+#ifdef WORD_TIMERS
+static const char* phase_names[NUM_PHASES] = {"read", "tokenize", "insert", "merge", "sort", "print"};
+static unsigned long long phase_ticks[NUM_PHASES];
+static unsigned long long start_ticks;
+static struct timespec start_time;
+
+static inline unsigned long long timer_now(void) {
+#ifdef __x86_64__
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline void phase_add(enum phase phase, unsigned long long ticks) {
+    __atomic_fetch_add(&phase_ticks[phase], ticks, __ATOMIC_RELAXED);
+}
+
+static void timers_start(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    start_ticks = timer_now();
+}
+
+/* Prints one "phase seconds" pair per phase on a single line. */
+static void timers_report(FILE* outfile) {
+    struct timespec end_time;
+    unsigned long long ticks = timer_now() - start_ticks;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double seconds = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+    double per_tick = ticks > 0 ? seconds / ticks : 0;
+
+    fprintf(outfile, "timers");
+    for (int i = 0; i < NUM_PHASES; ++i) {
+        fprintf(outfile, " %s %.3f", phase_names[i], phase_ticks[i] * per_tick);
+    }
+    fprintf(outfile, "\n");
+}
+#else
+static inline unsigned long long timer_now(void) { return 0; }
+static inline void phase_add(enum phase phase, unsigned long long ticks) {}
+static void timers_start(void) {}
+static void timers_report(FILE* outfile) {}
+#endif
+
+/* Merges the tables of the threads after I into I's, then publishes it. */
+static void reduce_counts(long i) {
+    for (long stride = 1; i % (2 * stride) == 0 && i + stride < num_counters; stride *= 2) {
+        sem_wait(&counters[i + stride].merged);
+        if (counters[i].counts != counters[i + stride].counts) {
+            unsigned long long start = timer_now();
+            if (!merge_words(counters[i].counts, counters[i + stride].counts)) {
+                __atomic_store_n(&merge_failed, true, __ATOMIC_RELAXED);
+            }
+            phase_add(PHASE_MERGE, timer_now() - start);
+        }
+    }
+    sem_post(&counters[i].merged);
+}
+
+/*
+ * Counts the words of an in-memory buffer, the way count_words does a stream.
+ * Returns how many words it counted.
+ */
+static size_t count_buffer(word_count_list_t* wclist, const char* buf, size_t len) {
+    word_scanner_t scanner;
+    size_t start, word_len, words = 0;
+    unsigned long long tokenize = 0, insert = 0, lap = timer_now(), now;
+
+    scan_init(&scanner, buf, len);
+    while ((word_len = scan_next(&scanner, &start)) > 0) {
+        char *word = malloc(word_len + 1);
+        if (word == NULL) {
+            break;
+        }
+        lower_word(word, buf + start, word_len);
+        now = timer_now();
+        tokenize += now - lap;
+        if (add_word(wclist, word) == NULL) {
+            free(word);
+        }
+        lap = timer_now();
+        insert += lap - now;
+        ++words;
+    }
+    phase_add(PHASE_TOKENIZE, tokenize + (timer_now() - lap));
+    phase_add(PHASE_INSERT, insert);
+    return words;
+}
+
+/*
+ * Maps PATH read-only and stores its size in *LEN. Returns NULL if the file
+ * cannot be opened or mapped, or is empty.
+ */
+static const char* map_file(const char* path, size_t* len) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    *len = st.st_size;
+    void *buf = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(buf, *len, MADV_SEQUENTIAL);
+    return buf;
+}
+
 /* Helper function used to add multi-threading functionality. */
 void* threads_helper(void* args) {
-    FILE *file_ptr = fopen((char *) args, "r");
-    if (file_ptr == NULL) {
-        pthread_exit(NULL);
+    counter_t *counter = args;
+
+    size_t len;
+    unsigned long long start = timer_now();
+    const char *buf = map_file(counter->path, &len);
+    phase_add(PHASE_READ, timer_now() - start);
+    if (buf != NULL) {
+        count_buffer(counter->counts, buf, len);
+        munmap((void *) buf, len);
+    } else {
+        /* Pipes and other unmappable inputs go through stdio. */
+        FILE *file_ptr = fopen(counter->path, "r");
+        if (file_ptr != NULL) {
+            start = timer_now();
+            count_words(counter->counts, file_ptr);
+            phase_add(PHASE_INSERT, timer_now() - start);
+            fclose(file_ptr);
+        }
     }
-    count_words(&word_counts, file_ptr);
 
-    fclose(file_ptr);
+    reduce_counts(counter - counters);
+    pthread_exit(NULL);
+}
+
+/* Worker for -j mode: counts chunks until the queue runs dry. */
+void* chunk_helper(void* args) {
+    counter_t *counter = args;
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&next_chunk, 1, __ATOMIC_RELAXED)) < num_chunks) {
+        count_buffer(counter->counts, chunks[i].buf, chunks[i].len);
+    }
+
+    reduce_counts(counter - counters);
     pthread_exit(NULL);
 }
 
 /*
- * main - handle command line, spawning one thread per file.
+ * Maps every file and cuts each into PIECES chunks on word boundaries.
+ * Files that cannot be mapped are skipped, so -j only takes regular files.
  */
-int main(int argc, char* argv[]) {
-  /* Create the empty data structure. */
-  init_words(&word_counts);
+static int split_files(char** paths, int num_paths, int pieces) {
+    chunks = malloc(sizeof(chunk_t) * num_paths * pieces);
+    if (chunks == NULL) {
+        return -1;
+    }
 
-  if (argc <= 1) {
-    /* Process stdin in a single thread. */
-    count_words(&word_counts, stdin);
-  } else {
-    int num_threads = argc - 1;
+    for (int f = 0; f < num_paths; ++f) {
+        size_t len;
+        unsigned long long start = timer_now();
+        const char *buf = map_file(paths[f], &len);
+        phase_add(PHASE_READ, timer_now() - start);
+        if (buf == NULL) {
+            continue;
+        }
+
+        size_t begin = 0;
+        for (int p = 1; p <= pieces && begin < len; ++p) {
+            size_t end = word_boundary(buf, len, len / pieces * p);
+            if (p == pieces) {
+                end = len;
+            }
+            if (end > begin) {
+                chunks[num_chunks].buf = buf + begin;
+                chunks[num_chunks].len = end - begin;
+                ++num_chunks;
+            }
+            begin = end;
+        }
+    }
+    return 0;
+}
+
+/* Starts one thread per counter running HELPER, then waits for all of them. */
+static int run_counters(void* (*helper)(void*), char** paths, int num_threads) {
     pthread_t *threads_arr = malloc(sizeof(pthread_t) * num_threads);
-    if (threads_arr == NULL) {
+    counters = calloc(num_threads, sizeof(counter_t));
+    if (threads_arr == NULL || counters == NULL) {
         return -1;
     }
-
-    pthread_mutex_init(&(word_counts.lock), NULL);
+    num_counters = num_threads;
 
     long tid;
     for (tid = 0; tid < num_threads; ++tid) {
-        int return_val = pthread_create(&threads_arr[tid], NULL, threads_helper, (void *) argv[tid + 1]);
+        counters[tid].path = paths != NULL ? paths[tid] : NULL;
+        if (tid == 0 || share_counts) {
+            counters[tid].counts = &word_counts;
+        } else {
+            counters[tid].counts = malloc(sizeof(word_count_list_t));
+            if (counters[tid].counts == NULL) {
+                return -1;
+            }
+            init_private_words(counters[tid].counts);
+        }
+        sem_init(&counters[tid].merged, 0, 0);
+    }
+
+    for (tid = 0; tid < num_threads; ++tid) {
+        int return_val = pthread_create(&threads_arr[tid], NULL, helper, &counters[tid]);
+        if (return_val) {
+            printf("ERROR; return code from pthread_create() is %d\n", return_val);
+            exit(-1);
+        }
+    }
+
+    for (tid = 0; tid < num_threads; ++tid) {
+        int ret_val = pthread_join(threads_arr[tid], NULL);
+        if (ret_val) {
+            return -1;
+        }
+    }
+    for (tid = 0; tid < num_threads; ++tid) {
+        sem_destroy(&counters[tid].merged);
+        if (counters[tid].counts != &word_counts) {
+            free_words(counters[tid].counts);
+            free(counters[tid].counts);
+        }
+    }
+    free(counters);
+    free(threads_arr);
+    if (merge_failed) {
+        fprintf(stderr, "out of memory merging word counts\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Streaming mode. One reader thread per input keeps reading, tailing regular
+ * files with --follow, while the main thread prints a snapshot every INTERVAL
+ * seconds or EVERY words.
+ *
+ * Each reader owns two private tables and counts into tables[epoch % 2]. To
+ * take a snapshot, the main thread bumps the epoch, waits only for readers
+ * that are in the middle of a batch from the old epoch, and then drains the
+ * old tables, which nobody writes to any more. Readers never wait for the
+ * snapshot: their next batch simply goes into the other table. ACTIVE is
+ * epoch + 1 while a reader is counting and 0 while it is reading, and is
+ * checked against the epoch again after being set, so either the reader sees
+ * the new epoch or the main thread sees the reader.
+ */
+typedef struct stream {
+  char* path;
+  word_count_list_t tables[2];
+  unsigned long active;
+  bool done;
+} stream_t;
+
+static stream_t* streams;
+static int num_streams;
+static unsigned long epoch;
+static unsigned long pending_words;
+static sem_t wake;
+
+static bool follow;
+static unsigned long every_words;
+
+/* Read size for streamed input. Longer words grow the buffer. */
+#define STREAM_BUF_SIZE (64 * 1024)
+
+/* How long --follow waits at the end of a file before reading again. */
+#define FOLLOW_POLL_USEC 100000
+
+/* Counts a batch of whole words into the table of the current epoch. */
+static void stream_count(stream_t* stream, const char* buf, size_t len) {
+    unsigned long e = __atomic_load_n(&epoch, __ATOMIC_SEQ_CST), seen;
+
+    for (;;) {
+        __atomic_store_n(&stream->active, e + 1, __ATOMIC_SEQ_CST);
+        seen = __atomic_load_n(&epoch, __ATOMIC_SEQ_CST);
+        if (seen == e) {
+            break;
+        }
+        e = seen;
+    }
+    size_t words = count_buffer(&stream->tables[e % 2], buf, len);
+    __atomic_store_n(&stream->active, 0, __ATOMIC_RELEASE);
+
+    if (every_words > 0) {
+        unsigned long before = __atomic_fetch_add(&pending_words, words, __ATOMIC_RELAXED);
+        if (before < every_words && before + words >= every_words) {
+            sem_post(&wake);
+        }
+    }
+}
+
+/* Reader thread: counts its input until EOF, or forever with --follow. */
+void* stream_helper(void* args) {
+    stream_t *stream = args;
+    size_t cap = STREAM_BUF_SIZE, carry = 0;
+    char *buf = malloc(cap);
+    int fd = stream->path != NULL ? open(stream->path, O_RDONLY) : STDIN_FILENO;
+
+    while (fd >= 0 && buf != NULL) {
+        unsigned long long start = timer_now();
+        ssize_t n = read(fd, buf + carry, cap - carry);
+        phase_add(PHASE_READ, timer_now() - start);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0 && follow && stream->path != NULL) {
+            usleep(FOLLOW_POLL_USEC);
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+
+        /* A word running to the end of the buffer may go on in the next read. */
+        size_t len = carry + n;
+        size_t cut = word_tail(buf, len);
+        if (cut == 0 && len == cap) {
+            char *bigger = realloc(buf, cap * 2);
+            if (bigger == NULL) {
+                break;
+            }
+            buf = bigger;
+            cap *= 2;
+            carry = len;
+            continue;
+        }
+        stream_count(stream, buf, cut);
+        memmove(buf, buf + cut, len - cut);
+        carry = len - cut;
+    }
+    if (buf != NULL && carry > 0) {
+        stream_count(stream, buf, carry);
+    }
+
+    if (fd > STDIN_FILENO) {
+        close(fd);
+    }
+    free(buf);
+    __atomic_store_n(&stream->done, true, __ATOMIC_RELEASE);
+    sem_post(&wake);
+    pthread_exit(NULL);
+}
+
+/* Ends the current epoch and moves everything counted in it into DELTA. */
+static void stream_collect(word_count_list_t* delta) {
+    unsigned long old = __atomic_fetch_add(&epoch, 1, __ATOMIC_SEQ_CST);
+
+    __atomic_store_n(&pending_words, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < num_streams; ++i) {
+        while (__atomic_load_n(&streams[i].active, __ATOMIC_ACQUIRE) == old + 1) {
+            sched_yield();
+        }
+        unsigned long long start = timer_now();
+        /* Words that do not fit stay in the table for a later snapshot. */
+        merge_words(delta, &streams[i].tables[old % 2]);
+        phase_add(PHASE_MERGE, timer_now() - start);
+    }
+}
+
+static bool streams_done(void) {
+    for (int i = 0; i < num_streams; ++i) {
+        if (!__atomic_load_n(&streams[i].done, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Runs streaming mode over PATHS, or stdin if there are none. Prints the
+ * running totals at every snapshot, or with DELTA only the counts added
+ * since the previous one, each under a "# snapshot N" or "# delta N" line.
+ * The last snapshot is taken once every input has ended.
+ */
+static int run_streams(char** paths, int num_paths, double interval, bool delta) {
+    num_streams = num_paths > 0 ? num_paths : 1;
+    streams = calloc(num_streams, sizeof(stream_t));
+    pthread_t *threads_arr = malloc(sizeof(pthread_t) * num_streams);
+    if (streams == NULL || threads_arr == NULL) {
+        return -1;
+    }
+    sem_init(&wake, 0, 0);
+
+    for (int i = 0; i < num_streams; ++i) {
+        streams[i].path = num_paths > 0 ? paths[i] : NULL;
+        init_private_words(&streams[i].tables[0]);
+        init_private_words(&streams[i].tables[1]);
+        int return_val = pthread_create(&threads_arr[i], NULL, stream_helper, &streams[i]);
         if (return_val) {
             printf("ERROR; return code from pthread_create() is %d\n", return_val);
             exit(-1);
         }
     }
 
-      for (tid = 0; tid < num_threads; ++tid) {
-          int ret_val = pthread_join(threads_arr[tid], NULL);
-          if (ret_val) {
-              return -1;
-          }
-      }
-      free(threads_arr);
+    word_count_list_t fresh;
+    init_private_words(&fresh);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    for (unsigned long snapshot = 1;; ++snapshot) {
+        bool finished;
+
+        deadline.tv_sec += (time_t) interval;
+        deadline.tv_nsec += (long) ((interval - (time_t) interval) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        for (;;) {
+            int r = interval > 0 ? sem_timedwait(&wake, &deadline) : sem_wait(&wake);
+            finished = streams_done();
+            if ((r < 0 && errno == ETIMEDOUT) || finished ||
+                (every_words > 0 && __atomic_load_n(&pending_words, __ATOMIC_RELAXED) >= every_words)) {
+                break;
+            }
+        }
+
+        stream_collect(&fresh);
+        if (delta) {
+            printf("# delta %lu\n", snapshot);
+            wordcount_sort(&fresh, less_count);
+            fprint_words(&fresh, stdout);
+            free_words(&fresh);
+            init_private_words(&fresh);
+        } else {
+            printf("# snapshot %lu\n", snapshot);
+            merge_words(&word_counts, &fresh);
+            wordcount_sort(&word_counts, less_count);
+            fprint_words(&word_counts, stdout);
+        }
+        fflush(stdout);
+
+        if (finished) {
+            break;
+        }
+        if (interval > 0) {
+            clock_gettime(CLOCK_REALTIME, &deadline);
+        }
+    }
+
+    for (int i = 0; i < num_streams; ++i) {
+        pthread_join(threads_arr[i], NULL);
+        free_words(&streams[i].tables[0]);
+        free_words(&streams[i].tables[1]);
+    }
+    sem_destroy(&wake);
+    free_words(&fresh);
+    free(streams);
+    free(threads_arr);
+    return 0;
+}
+
+/*
+ * Prints the K most frequent words in less_count order, the same lines the
+ * last K of the full output would be, without sorting the whole list.
+ */
+static int fprint_top_words(word_count_list_t* wclist, size_t k, FILE* outfile) {
+    word_count_t **arr = malloc(len_words(wclist) * sizeof(word_count_t *));
+    if (arr == NULL) {
+        return -1;
+    }
+
+    unsigned long long start = timer_now();
+    size_t n = select_top(arr, wordcount_entries(wclist, arr), k, less_count);
+    unsigned long long sorted = timer_now();
+    for (size_t i = 0; i < n; ++i) {
+        fprintf(outfile, "%i\t%s\n", arr[i]->count, arr[i]->word);
+    }
+    fflush(outfile);
+    phase_add(PHASE_SORT, sorted - start);
+    phase_add(PHASE_PRINT, timer_now() - sorted);
+    free(arr);
+    return 0;
+}
+
+/*
+ * main - handle command line, spawning one thread per file.
+ *
+ * With -j N, every file is instead mapped and split into N chunks, which a
+ * pool of N threads counts. This lets a single large file use all cores.
+ * With --top K, only the K most frequent words are printed. --shared has all
+ * threads add to one table rather than merging private ones.
+ *
+ * With --interval SECONDS or --every WORDS, pwords runs as a service instead:
+ * it keeps reading its inputs and prints a sorted snapshot of the counts so
+ * far at that cadence, or with --delta just the counts added since the last
+ * snapshot. --follow keeps reading files past their end, like tail -f.
+ */
+int main(int argc, char* argv[]) {
+  static const struct option long_options[] = {
+    {"top", required_argument, NULL, 't'},
+    {"interval", required_argument, NULL, 'i'},
+    {"every", required_argument, NULL, 'm'},
+    {"delta", no_argument, NULL, 'd'},
+    {"follow", no_argument, NULL, 'f'},
+    {"shared", no_argument, NULL, 's'},
+    {NULL, 0, NULL, 0},
+  };
+  int jobs = 0;
+  long top = 0;
+  double interval = 0;
+  bool streaming = false, delta = false;
+  int opt;
+
+  while ((opt = getopt_long(argc, argv, "j:i:m:dfs", long_options, NULL)) != -1) {
+    if (opt == 'j' && atoi(optarg) > 0) {
+      jobs = atoi(optarg);
+    } else if (opt == 't' && atol(optarg) > 0) {
+      top = atol(optarg);
+    } else if (opt == 'i' && atof(optarg) > 0) {
+      interval = atof(optarg);
+      streaming = true;
+    } else if (opt == 'm' && atol(optarg) > 0) {
+      every_words = atol(optarg);
+      streaming = true;
+    } else if (opt == 's') {
+      share_counts = true;
+    } else if (opt == 'd' || opt == 'f') {
+      delta |= opt == 'd';
+      follow |= opt == 'f';
+      streaming = true;
+    } else {
+      fprintf(stderr, "Usage: %s [-j N] [--top K] [--shared] [FILE]...\n"
+                      "       %s [-i SECONDS] [-m WORDS] [--delta] [--follow] [FILE]...\n",
+              argv[0], argv[0]);
+      return 1;
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  timers_start();
+  if (streaming) {
+    init_words(&word_counts);
+    if (run_streams(argv + 1, argc - 1, interval > 0 || every_words > 0 ? interval : 10, delta) < 0) {
+      return -1;
+    }
+    free_words(&word_counts);
+    timers_report(stderr);
+    pthread_exit(NULL);
+  }
+
+  /* Create the empty data structure. Only thread 0 writes to it unless the
+   * threads share it. */
+  if (share_counts) {
+    init_words(&word_counts);
+  } else {
+    init_private_words(&word_counts);
+  }
+
+  if (argc <= 1) {
+    /* Process stdin in a single thread. */
+    unsigned long long start = timer_now();
+    count_words(&word_counts, stdin);
+    phase_add(PHASE_INSERT, timer_now() - start);
+  } else if (jobs > 0) {
+    if (split_files(argv + 1, argc - 1, jobs) < 0 || run_counters(chunk_helper, NULL, jobs) < 0) {
+      return -1;
+    }
+  } else if (run_counters(threads_helper, argv + 1, argc - 1) < 0) {
+    return -1;
   }
 
   /* Output final result of all threads' work. */
-  wordcount_sort(&word_counts, less_count);
-  fprint_words(&word_counts, stdout);
+  if (top > 0) {
+    if (fprint_top_words(&word_counts, top, stdout) < 0) {
+      return -1;
+    }
+  } else {
+    unsigned long long start = timer_now();
+    wordcount_sort(&word_counts, less_count);
+    unsigned long long sorted = timer_now();
+    fprint_words(&word_counts, stdout);
+    fflush(stdout);
+    phase_add(PHASE_SORT, sorted - start);
+    phase_add(PHASE_PRINT, timer_now() - sorted);
+  }
+  free_words(&word_counts);
+  timers_report(stderr);
   pthread_exit(NULL);
 }
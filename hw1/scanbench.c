@@ -0,0 +1,173 @@
+/*
+ * Tokenizer microbenchmark. Finds every word of a file the way count_words
+ * does, once through stdio one character at a time and once through the
+ * word_scan functions over a mapping of the file, and reports MB/s for each.
+ * Only tokenizing and lowercasing are timed; no words are counted.
+ *
+ *   ./scanbench [-r ROUNDS] FILE
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "word_scan.h"
+
+/* Summary of one pass, so the two tokenizers can be checked against each other. */
+typedef struct scan_result {
+  size_t words;
+  size_t letters;
+  unsigned long checksum;
+} scan_result_t;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Folds a finished word into RESULT. */
+static void record(scan_result_t* result, const char* word, size_t len) {
+  result->words++;
+  result->letters += len;
+  for (size_t i = 0; i < len; i++) {
+    result->checksum = result->checksum * 31 + (unsigned char)word[i];
+  }
+}
+
+/* The count_words loop: fgetc, isalpha and tolower into a growing buffer. */
+static scan_result_t scan_stdio(const char* path) {
+  scan_result_t result = {0, 0, 0};
+  size_t cap = 64, len = 0;
+  char* word = malloc(cap);
+  FILE* infile = fopen(path, "r");
+  int c;
+
+  if (infile == NULL || word == NULL) {
+    perror(path);
+    exit(1);
+  }
+  do {
+    c = fgetc(infile);
+    if (c != EOF && isalpha(c)) {
+      if (len + 1 == cap) {
+        word = realloc(word, cap *= 2);
+      }
+      word[len++] = tolower(c);
+    } else {
+      if (len > 1) {
+        word[len] = '\0';
+        record(&result, word, len);
+      }
+      len = 0;
+    }
+  } while (c != EOF);
+
+  fclose(infile);
+  free(word);
+  return result;
+}
+
+/* The pwords path: scan_next and lower_word over a mapping of the file. */
+static scan_result_t scan_mapped(const char* buf, size_t size) {
+  scan_result_t result = {0, 0, 0};
+  word_scanner_t scanner;
+  size_t cap = 64, start, len;
+  char* word = malloc(cap);
+
+  scan_init(&scanner, buf, size);
+  while ((len = scan_next(&scanner, &start)) > 0) {
+    if (len + 1 > cap) {
+      word = realloc(word, cap = 2 * (len + 1));
+    }
+    lower_word(word, buf + start, len);
+    record(&result, word, len);
+  }
+  free(word);
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  int rounds = 5;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:")) != -1) {
+    if (opt == 'r' && atoi(optarg) > 0) {
+      rounds = atoi(optarg);
+    } else {
+      optind = argc;
+      break;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "Usage: %s [-r ROUNDS] FILE\n", argv[0]);
+    return 1;
+  }
+  const char* path = argv[optind];
+
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+    fprintf(stderr, "%s: cannot open, or empty\n", path);
+    return 1;
+  }
+  size_t size = st.st_size;
+  const char* buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (buf == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+
+  double best_stdio = 0, best_mapped = 0;
+  scan_result_t stdio_result, mapped_result;
+  for (int r = 0; r < rounds; r++) {
+    double start = now();
+    stdio_result = scan_stdio(path);
+    double mid = now();
+    mapped_result = scan_mapped(buf, size);
+    double end = now();
+
+    if (r == 0 || mid - start < best_stdio) {
+      best_stdio = mid - start;
+    }
+    if (r == 0 || end - mid < best_mapped) {
+      best_mapped = end - mid;
+    }
+  }
+
+  if (stdio_result.words != mapped_result.words || stdio_result.letters != mapped_result.letters ||
+      stdio_result.checksum != mapped_result.checksum) {
+    fprintf(stderr, "tokenizers disagree: stdio found %zu words, word_scan %zu\n",
+            stdio_result.words, mapped_result.words);
+    return 1;
+  }
+
+  double mb = size / 1e6;
+  printf("%.1f MB, %zu words, best of %d\n", mb, stdio_result.words, rounds);
+  printf("stdio     %8.1f MB/s\n", mb / best_stdio);
+  printf("word_scan %8.1f MB/s  (%.1fx)\n", mb / best_mapped, best_stdio / best_mapped);
+  munmap((void*)buf, size);
+  return 0;
+}
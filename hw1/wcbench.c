@@ -0,0 +1,213 @@
+/*
+ * Helpers for the bench target.
+ *
+ *   ./wcbench zipf [-s EXPONENT] [-v VOCABULARY] [-b BYTES] [-r SEED]
+ *
+ * writes a synthetic corpus to stdout: VOCABULARY random lowercase words,
+ * drawn with probability proportional to 1 / rank^EXPONENT until BYTES bytes
+ * have been written.
+ *
+ *   ./wcbench run OUTFILE COMMAND [ARG]...
+ *
+ * runs COMMAND with its stdout sent to OUTFILE, then prints its wall time in
+ * seconds and peak resident set size in MiB on one line of stderr.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/* Generated words are this many letters long, unless the vocabulary is so
+ * large that it takes more letters than MIN_WORD_LEN to tell them apart. */
+#define MIN_WORD_LEN 2
+#define MAX_WORD_LEN 12
+
+/* Words per output line. */
+#define LINE_WORDS 12
+
+/* xorshift64*, so a seed gives the same corpus everywhere. */
+static unsigned long long rng_state;
+
+static unsigned long long next_random(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+/* A uniform double in [0, 1). */
+static double next_unit(void) { return (next_random() >> 11) * (1.0 / (1ULL << 53)); }
+
+/*
+ * Returns VOCAB distinct random words. Each starts with its index spelled in
+ * base 26 at a fixed width, which keeps them distinct; the rest of its
+ * letters are random.
+ */
+static char** make_vocabulary(size_t vocab) {
+  char** words = malloc(vocab * sizeof(char*));
+  size_t width = 1;
+
+  if (words == NULL) {
+    return NULL;
+  }
+  for (size_t n = vocab - 1; n >= 26; n /= 26) {
+    width++;
+  }
+
+  for (size_t i = 0; i < vocab; i++) {
+    char buf[MAX_WORD_LEN + 32];
+    size_t len = 0;
+
+    for (size_t n = i; len < width; n /= 26) {
+      buf[len++] = 'a' + n % 26;
+    }
+    size_t target = MIN_WORD_LEN + next_random() % (MAX_WORD_LEN - MIN_WORD_LEN + 1);
+    while (len < target) {
+      buf[len++] = 'a' + next_random() % 26;
+    }
+    words[i] = strndup(buf, len);
+    if (words[i] == NULL) {
+      return NULL;
+    }
+  }
+  return words;
+}
+
+static int zipf(int argc, char* argv[]) {
+  double exponent = 1.0;
+  size_t vocab = 100000;
+  unsigned long long bytes = 64ULL << 20;
+  int opt;
+
+  rng_state = 88172645463325252ULL;
+  while ((opt = getopt(argc, argv, "s:v:b:r:")) != -1) {
+    if (opt == 's' && atof(optarg) > 0) {
+      exponent = atof(optarg);
+    } else if (opt == 'v' && atol(optarg) > 0) {
+      vocab = atol(optarg);
+    } else if (opt == 'b' && atoll(optarg) > 0) {
+      bytes = atoll(optarg);
+    } else if (opt == 'r' && strtoull(optarg, NULL, 0) != 0) {
+      rng_state = strtoull(optarg, NULL, 0);
+    } else {
+      fprintf(stderr, "Usage: wcbench zipf [-s EXPONENT] [-v VOCABULARY] [-b BYTES] [-r SEED]\n");
+      return 1;
+    }
+  }
+
+  char** words = make_vocabulary(vocab);
+  double* cdf = malloc(vocab * sizeof(double));
+  if (words == NULL || cdf == NULL) {
+    fprintf(stderr, "wcbench: out of memory\n");
+    return 1;
+  }
+  double total = 0;
+  for (size_t i = 0; i < vocab; i++) {
+    total += 1 / pow(i + 1, exponent);
+    cdf[i] = total;
+  }
+
+  unsigned long long written = 0;
+  for (int column = 1; written < bytes; column++) {
+    /* The first rank whose cumulative weight reaches the draw. */
+    double u = next_unit() * total;
+    size_t lo = 0, hi = vocab - 1;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (cdf[mid] < u) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    fputs(words[lo], stdout);
+    putchar(column % LINE_WORDS == 0 ? '\n' : ' ');
+    written += strlen(words[lo]) + 1;
+  }
+
+  for (size_t i = 0; i < vocab; i++) {
+    free(words[i]);
+  }
+  free(words);
+  free(cdf);
+  return fflush(stdout) == 0 ? 0 : 1;
+}
+
+static int run(int argc, char* argv[]) {
+  struct timespec start, end;
+  struct rusage usage;
+  int status;
+
+  if (argc < 3) {
+    fprintf(stderr, "Usage: wcbench run OUTFILE COMMAND [ARG]...\n");
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return 1;
+  }
+  if (pid == 0) {
+    int fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0) {
+      perror(argv[1]);
+      _exit(127);
+    }
+    close(fd);
+    execvp(argv[2], argv + 2);
+    perror(argv[2]);
+    _exit(127);
+  }
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    perror("wait4");
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  /* ru_maxrss is in KiB on Linux. */
+  fprintf(stderr, "wall %.3f rss %.1f\n",
+          (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9,
+          usage.ru_maxrss / 1024.0);
+  if (WIFSIGNALED(status)) {
+    return 128 + WTERMSIG(status);
+  }
+  return WEXITSTATUS(status);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc >= 2 && strcmp(argv[1], "zipf") == 0) {
+    return zipf(argc - 1, argv + 1);
+  }
+  if (argc >= 2 && strcmp(argv[1], "run") == 0) {
+    return run(argc - 1, argv + 1);
+  }
+  fprintf(stderr, "Usage: %s zipf [-s EXPONENT] [-v VOCABULARY] [-b BYTES] [-r SEED]\n"
+                  "       %s run OUTFILE COMMAND [ARG]...\n",
+          argv[0], argv[0]);
+  return 1;
+}
@@ -33,11 +33,77 @@
 
 /*
  * Representation of a word count object and word count list object.
- * PINTOS_LIST and/or PTHREADS are #define'd prior to #include to select the
- * representations.
+ * WORD_HASH, WORD_STRIPED or PINTOS_LIST, and/or PTHREADS are #define'd prior
+ * to #include to select the representations.
+ *
+ * word_helpers.o is compiled against these structs, so every word_count_t must
+ * start with the word and count fields.
+ */
+
+#if defined(WORD_HASH)
+typedef struct word_count {
+  char* word;
+  int count;
+  unsigned int hash;
+} word_count_t;
+
+#ifdef PTHREADS
+#include <pthread.h>
+#endif
+
+/*
+ * Open-addressed hash table of word counts. Each distinct word is stored once,
+ * in the string add_word took ownership of. ORDER is the sorted view left by
+ * wordcount_sort, and is dropped when a new word is added.
  */
+typedef struct word_count_list {
+  word_count_t** slots;
+  size_t capacity;
+  size_t size;
+  word_count_t** order;
+#ifdef PTHREADS
+  pthread_mutex_t lock;
+  bool shared;
+#endif
+} word_count_list_t;
+
+#elif defined(WORD_STRIPED)
+#ifndef PTHREADS
+#error "WORD_STRIPED needs PTHREADS"
+#endif
+#include <pthread.h>
+
+typedef struct word_count {
+  char* word;
+  int count;
+  unsigned int hash;
+} word_count_t;
+
+/* Number of stripes. A power of two; words pick one by the top bits of their hash. */
+#define WORD_STRIPES 64
 
-#ifdef PINTOS_LIST
+/*
+ * Concurrent hash map split into stripes, each with its own lock and table,
+ * padded to a cache line so stripes do not share one. Lookups and counts of
+ * words already present take no lock; see word_count_s.c. ORDER is the
+ * sorted view left by wordcount_sort, and is ignored once words are added.
+ */
+struct stripe_table;
+
+typedef struct word_stripe {
+  pthread_mutex_t lock;
+  struct stripe_table* table;
+  size_t size;
+} __attribute__((aligned(64))) word_stripe_t;
+
+typedef struct word_count_list {
+  word_stripe_t stripes[WORD_STRIPES];
+  word_count_t** order;
+  size_t order_len;
+  bool shared;
+} word_count_list_t;
+
+#elif defined(PINTOS_LIST)
 #include "list.h"
 typedef struct word_count {
   char* word;
@@ -47,15 +113,20 @@ typedef struct word_count {
 
 #ifdef PTHREADS
 #include <pthread.h>
+#include "arena.h"
+
+/* Nodes and their words are carved from ARENA and released together. */
 typedef struct word_count_list {
   struct list lst;
   pthread_mutex_t lock;
+  bool shared;
+  arena_t arena;
 } word_count_list_t;
 #else  /* PTHREADS */
 typedef struct list word_count_list_t;
 #endif /* PTHREADS */
 
-#else  /* PINTOS_LIST */
+#else  /* WORD_HASH, WORD_STRIPED, PINTOS_LIST */
 
 typedef struct word_count {
   char* word;
@@ -64,7 +135,7 @@ typedef struct word_count {
 } word_count_t;
 
 typedef word_count_t* word_count_list_t;
-#endif /* PINTOS_LIST */
+#endif /* WORD_HASH, WORD_STRIPED, PINTOS_LIST */
 
 /* Initialize a word count list. */
 void init_words(word_count_list_t* wclist);
@@ -87,4 +158,34 @@ void fprint_words(word_count_list_t* wclist, FILE* outfile);
 /* Sort a word count list using the provided comparator function. */
 void wordcount_sort(word_count_list_t* wclist, bool less(const word_count_t*, const word_count_t*));
 
+#if defined(WORD_HASH) || defined(PTHREADS)
+/*
+ * Free every entry of a word count list. The list must be initialized again
+ * before it is used.
+ */
+void free_words(word_count_list_t* wclist);
+#endif
+
+/*
+ * Store a pointer to every entry of a word count list in out, which must have
+ * room for len_words(wclist) of them. Returns how many were stored.
+ */
+size_t wordcount_entries(word_count_list_t* wclist, word_count_t** out);
+
+#ifdef PTHREADS
+/*
+ * Initialize a word count list that only one thread will use. add_word skips
+ * the lock for it. init_words makes a list any thread may add to.
+ */
+void init_private_words(word_count_list_t* wclist);
+
+/*
+ * Move every word of src into dst, adding up the counts of words in both.
+ * Leaves src empty. src must not be in use by another thread. Returns false
+ * if dst could not make room for every word, in which case the words that
+ * did not fit stay in src with their counts.
+ */
+bool merge_words(word_count_list_t* dst, word_count_list_t* src);
+#endif /* PTHREADS */
+
 #endif /* WORD_COUNT_H */
@@ -0,0 +1,286 @@
+/*
+ * Implementation of the word_count interface using an open-addressed hash
+ * table, optionally guarded by a pthread mutex.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_HASH
+#error "WORD_HASH must be #define'd when compiling word_count_h.c"
+#endif
+
+#include "word_count.h"
+#include "word_helpers.h"
+#include "word_rank.h"
+
+/* Initial number of slots. Always a power of two. */
+#define INITIAL_CAPACITY 1024
+
+/* 64-bit FNV-1a, folded to 32 bits. */
+static unsigned int hash_word(const char* word) {
+  unsigned long long hash = 14695981039346656037ULL;
+
+  for (; *word != '\0'; ++word) {
+    hash ^= (unsigned char)*word;
+    hash *= 1099511628211ULL;
+  }
+  return (unsigned int)(hash ^ (hash >> 32));
+}
+
+/* Returns the slot holding WORD, or the empty slot where it would go. */
+static word_count_t** probe(word_count_list_t* wclist, const char* word, unsigned int hash) {
+  size_t mask = wclist->capacity - 1;
+  size_t i = hash & mask;
+
+  while (wclist->slots[i] != NULL) {
+    word_count_t* wc = wclist->slots[i];
+    if (wc->hash == hash && strcmp(wc->word, word) == 0) {
+      break;
+    }
+    i = (i + 1) & mask;
+  }
+  return &wclist->slots[i];
+}
+
+/* Doubles the table. Returns false if memory ran out. */
+static bool grow(word_count_list_t* wclist) {
+  word_count_t** old_slots = wclist->slots;
+  size_t old_capacity = wclist->capacity;
+
+  wclist->slots = calloc(2 * old_capacity, sizeof(word_count_t*));
+  if (wclist->slots == NULL) {
+    wclist->slots = old_slots;
+    return false;
+  }
+  wclist->capacity = 2 * old_capacity;
+
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old_slots[i] != NULL) {
+      *probe(wclist, old_slots[i]->word, old_slots[i]->hash) = old_slots[i];
+    }
+  }
+  free(old_slots);
+  return true;
+}
+
+void init_words(word_count_list_t* wclist) {
+  wclist->slots = calloc(INITIAL_CAPACITY, sizeof(word_count_t*));
+  wclist->capacity = wclist->slots != NULL ? INITIAL_CAPACITY : 0;
+  wclist->size = 0;
+  wclist->order = NULL;
+#ifdef PTHREADS
+  pthread_mutex_init(&wclist->lock, NULL);
+  wclist->shared = true;
+#endif
+}
+
+size_t len_words(word_count_list_t* wclist) { return wclist->size; }
+
+word_count_t* find_word(word_count_list_t* wclist, char* word) {
+  if (wclist == NULL || wclist->capacity == 0) {
+    return NULL;
+  }
+  return *probe(wclist, word, hash_word(word));
+}
+
+word_count_t* add_word(word_count_list_t* wclist, char* word) {
+  word_count_t** slot;
+  word_count_t* wc = NULL;
+  unsigned int hash;
+
+  if (wclist == NULL || wclist->capacity == 0) {
+    return NULL;
+  }
+  hash = hash_word(word);
+
+#ifdef PTHREADS
+  if (wclist->shared) {
+    pthread_mutex_lock(&wclist->lock);
+  }
+#endif
+  slot = probe(wclist, word, hash);
+  if (*slot != NULL) {
+    wc = *slot;
+    wc->count++;
+    /* The table already holds this word; drop the caller's copy. */
+    free(word);
+  } else if (4 * (wclist->size + 1) <= 3 * wclist->capacity || grow(wclist)) {
+    wc = malloc(sizeof(word_count_t));
+    if (wc != NULL) {
+      wc->word = word;
+      wc->count = 1;
+      wc->hash = hash;
+      *probe(wclist, word, hash) = wc;
+      wclist->size++;
+      free(wclist->order);
+      wclist->order = NULL;
+    }
+  }
+#ifdef PTHREADS
+  if (wclist->shared) {
+    pthread_mutex_unlock(&wclist->lock);
+  }
+#endif
+  return wc;
+}
+
+#ifdef PTHREADS
+/*
+ * Puts every entry of WCLIST back within reach of probe() after other entries
+ * were taken out from between it and its home slot. Each move brings an entry
+ * closer to home, so the passes stop.
+ */
+static void reseat(word_count_list_t* wclist) {
+  bool moved;
+
+  do {
+    moved = false;
+    for (size_t i = 0; i < wclist->capacity; i++) {
+      word_count_t* wc = wclist->slots[i];
+      word_count_t** slot;
+
+      if (wc == NULL) {
+        continue;
+      }
+      slot = probe(wclist, wc->word, wc->hash);
+      if (*slot == NULL) {
+        *slot = wc;
+        wclist->slots[i] = NULL;
+        moved = true;
+      }
+    }
+  } while (moved);
+}
+
+void init_private_words(word_count_list_t* wclist) {
+  init_words(wclist);
+  wclist->shared = false;
+}
+
+bool merge_words(word_count_list_t* dst, word_count_list_t* src) {
+  size_t kept = 0;
+
+  if (dst == NULL || src == NULL || dst->capacity == 0) {
+    return false;
+  }
+
+  if (dst->shared) {
+    pthread_mutex_lock(&dst->lock);
+  }
+  for (size_t i = 0; i < src->capacity; i++) {
+    word_count_t* wc = src->slots[i];
+    word_count_t** slot;
+
+    if (wc == NULL) {
+      continue;
+    }
+
+    slot = probe(dst, wc->word, wc->hash);
+    if (*slot != NULL) {
+      (*slot)->count += wc->count;
+      free(wc->word);
+      free(wc);
+    } else if (4 * (dst->size + 1) <= 3 * dst->capacity || grow(dst)) {
+      *probe(dst, wc->word, wc->hash) = wc;
+      dst->size++;
+    } else {
+      /* Out of memory; the word stays where it is. */
+      kept++;
+      continue;
+    }
+    src->slots[i] = NULL;
+  }
+  src->size = kept;
+  if (kept > 0) {
+    reseat(src);
+  }
+  free(src->order);
+  src->order = NULL;
+  free(dst->order);
+  dst->order = NULL;
+  if (dst->shared) {
+    pthread_mutex_unlock(&dst->lock);
+  }
+  return kept == 0;
+}
+#endif /* PTHREADS */
+
+void free_words(word_count_list_t* wclist) {
+  for (size_t i = 0; i < wclist->capacity; i++) {
+    if (wclist->slots[i] != NULL) {
+      free(wclist->slots[i]->word);
+      free(wclist->slots[i]);
+    }
+  }
+  free(wclist->slots);
+  free(wclist->order);
+  wclist->slots = NULL;
+  wclist->order = NULL;
+  wclist->capacity = 0;
+  wclist->size = 0;
+}
+
+void fprint_words(word_count_list_t* wclist, FILE* outfile) {
+  if (wclist == NULL) {
+    return;
+  }
+
+  if (wclist->order != NULL) {
+    for (size_t i = 0; i < wclist->size; i++) {
+      fprintf(outfile, "%i\t%s\n", wclist->order[i]->count, wclist->order[i]->word);
+    }
+    return;
+  }
+  for (size_t i = 0; i < wclist->capacity; i++) {
+    if (wclist->slots[i] != NULL) {
+      fprintf(outfile, "%i\t%s\n", wclist->slots[i]->count, wclist->slots[i]->word);
+    }
+  }
+}
+
+size_t wordcount_entries(word_count_list_t* wclist, word_count_t** out) {
+  size_t n = 0;
+
+  for (size_t i = 0; i < wclist->capacity; i++) {
+    if (wclist->slots[i] != NULL) {
+      out[n++] = wclist->slots[i];
+    }
+  }
+  return n;
+}
+
+void wordcount_sort(word_count_list_t* wclist, bool less(const word_count_t*, const word_count_t*)) {
+  size_t n;
+
+  if (wclist == NULL) {
+    return;
+  }
+  free(wclist->order);
+  wclist->order = malloc(wclist->size * sizeof(word_count_t*));
+  if (wclist->order == NULL) {
+    return;
+  }
+
+  n = wordcount_entries(wclist, wclist->order);
+  if (less == less_count && sort_by_count(wclist->order, n)) {
+    return;
+  }
+  if (!sort_entries(wclist->order, n, less)) {
+    free(wclist->order);
+    wclist->order = NULL;
+  }
+}
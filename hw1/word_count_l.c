@@ -25,6 +25,8 @@
 #endif
 
 #include "word_count.h"
+#include "word_helpers.h"
+#include "word_rank.h"
 
 void init_words(word_count_list_t* wclist) {
     list_init(wclist);
@@ -104,6 +106,19 @@ static bool less_list(const struct list_elem* ewc1, const struct list_elem* ewc2
   return (*custom_comparator)(obj1, obj2);
 }
 
+size_t wordcount_entries(word_count_list_t* wclist, word_count_t** out) {
+  size_t n = 0;
+  struct list_elem *e;
+
+  for (e = list_begin(wclist); e != list_end(wclist); e = list_next(e)) {
+      out[n++] = list_entry(e, word_count_t, elem);
+  }
+  return n;
+}
+
 void wordcount_sort(word_count_list_t* wclist, bool less(const word_count_t*, const word_count_t*)) {
+  if (less == less_count && sort_list_by_count(wclist, offsetof(word_count_t, elem))) {
+      return;
+  }
   list_sort(wclist, less_list, less);
 }
@@ -29,9 +29,19 @@
 #endif
 
 #include "word_count.h"
+#include "word_helpers.h"
+#include "word_rank.h"
 
 void init_words(word_count_list_t* wclist) {
     list_init(&(wclist->lst));
+    pthread_mutex_init(&(wclist->lock), NULL);
+    wclist->shared = true;
+    arena_init(&(wclist->arena));
+}
+
+void init_private_words(word_count_list_t* wclist) {
+    init_words(wclist);
+    wclist->shared = false;
 }
 
 size_t len_words(word_count_list_t* wclist) {
@@ -59,33 +69,70 @@ word_count_t* add_word(word_count_list_t* wclist, char* word) {
         return NULL;
     }
 
-    pthread_mutex_lock(&(wclist->lock));
+    if (wclist->shared) {
+        pthread_mutex_lock(&(wclist->lock));
+    }
     word_count_t *found_word = find_word(wclist, word);
 
     if (found_word == NULL) {
-        found_word = (word_count_t *) malloc(sizeof(word_count_t));
-        if (found_word == NULL) {
-            return NULL;
+        found_word = arena_alloc(&(wclist->arena), sizeof(word_count_t));
+        if (found_word != NULL) {
+            found_word->word = arena_strndup(&(wclist->arena), word, strlen(word));
+            if (found_word->word == NULL) {
+                found_word = NULL;
+            }
         }
 
-        found_word->word = (char *) malloc(sizeof(char) * (strlen(word) + 1));
-        if (found_word->word == NULL) {
-            return NULL;
+        if (found_word != NULL) {
+            found_word->count = 1;
+            list_push_back(&(wclist->lst), &(found_word->elem));
         }
-
-        strcpy(found_word->word, word);
-        found_word->count = 1;
-
-        list_push_back(&(wclist->lst), &(found_word->elem));
-
   } else {
       found_word->count = found_word->count + 1;
   }
 
-    pthread_mutex_unlock(&(wclist->lock));
+    if (wclist->shared) {
+        pthread_mutex_unlock(&(wclist->lock));
+    }
+
+    /* The list keeps its own copy in the arena. */
+    if (found_word != NULL) {
+        free(word);
+    }
     return found_word;
 }
 
+bool merge_words(word_count_list_t* dst, word_count_list_t* src) {
+    if (dst == NULL || src == NULL) {
+        return false;
+    }
+
+    if (dst->shared) {
+        pthread_mutex_lock(&(dst->lock));
+    }
+    while (!list_empty(&(src->lst))) {
+        word_count_t *obj = list_entry(list_pop_front(&(src->lst)), word_count_t, elem);
+        word_count_t *found_word = find_word(dst, obj->word);
+
+        if (found_word == NULL) {
+            list_push_back(&(dst->lst), &(obj->elem));
+        } else {
+            found_word->count += obj->count;
+        }
+    }
+    /* Moved nodes still live in src's arena, so dst takes it over. */
+    arena_adopt(&(dst->arena), &(src->arena));
+    if (dst->shared) {
+        pthread_mutex_unlock(&(dst->lock));
+    }
+    return true;
+}
+
+void free_words(word_count_list_t* wclist) {
+    arena_release(&(wclist->arena));
+    list_init(&(wclist->lst));
+}
+
 void fprint_words(word_count_list_t* wclist, FILE* outfile) {
     if (wclist == NULL) {
         return;
@@ -112,6 +159,19 @@ static bool less_list(const struct list_elem* ewc1, const struct list_elem* ewc2
   return (*custom_comparator)(obj1, obj2);
 }
 
+size_t wordcount_entries(word_count_list_t* wclist, word_count_t** out) {
+  size_t n = 0;
+  struct list_elem *e;
+
+  for (e = list_begin(&(wclist->lst)); e != list_end(&(wclist->lst)); e = list_next(e)) {
+      out[n++] = list_entry(e, word_count_t, elem);
+  }
+  return n;
+}
+
 void wordcount_sort(word_count_list_t* wclist, bool less(const word_count_t*, const word_count_t*)) {
+  if (less == less_count && sort_list_by_count(&(wclist->lst), offsetof(word_count_t, elem))) {
+      return;
+  }
   list_sort(&(wclist->lst), less_list, less);
 }
@@ -0,0 +1,388 @@
+/*
+ * Implementation of the word_count interface as a lock-striped concurrent
+ * hash map.
+ *
+ * Each stripe owns an open-addressed table of node pointers. A slot only ever
+ * goes from NULL to a node, and a full table is replaced by a bigger copy
+ * rather than rehashed in place, with the old one kept until free_words. So
+ * any table a reader can reach stays valid, and a lookup can probe it without
+ * the lock. A word that is found is counted with an atomic add; only inserts
+ * take the stripe lock, and they probe again under it in case the word went
+ * in or the table grew meanwhile.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_STRIPED
+#error "WORD_STRIPED must be #define'd when compiling word_count_s.c"
+#endif
+
+#include "word_count.h"
+#include "word_helpers.h"
+#include "word_rank.h"
+
+/* Initial number of slots per stripe. Always a power of two. */
+#define INITIAL_CAPACITY 64
+
+struct stripe_table {
+  size_t capacity;
+  struct stripe_table* retired;
+  word_count_t* slots[];
+};
+
+/* 64-bit FNV-1a, folded to 32 bits. */
+static unsigned int hash_word(const char* word) {
+  unsigned long long hash = 14695981039346656037ULL;
+
+  for (; *word != '\0'; ++word) {
+    hash ^= (unsigned char)*word;
+    hash *= 1099511628211ULL;
+  }
+  return (unsigned int)(hash ^ (hash >> 32));
+}
+
+/* The top bits of the hash pick the stripe, the low bits the slot. */
+static word_stripe_t* stripe_of(word_count_list_t* wclist, unsigned int hash) {
+  return &wclist->stripes[hash >> (32 - __builtin_ctz(WORD_STRIPES))];
+}
+
+static struct stripe_table* new_table(size_t capacity) {
+  struct stripe_table* table =
+      calloc(1, sizeof(struct stripe_table) + capacity * sizeof(word_count_t*));
+
+  if (table != NULL) {
+    table->capacity = capacity;
+  }
+  return table;
+}
+
+/*
+ * Returns the slot of TABLE holding WORD, or the empty slot where it would go.
+ * The slot is only worth anything while no one else can fill it, so the
+ * caller holds the stripe lock or owns the table.
+ */
+static word_count_t** probe(struct stripe_table* table, const char* word, unsigned int hash) {
+  size_t mask = table->capacity - 1;
+  size_t i = hash & mask;
+  word_count_t* wc;
+
+  while ((wc = __atomic_load_n(&table->slots[i], __ATOMIC_ACQUIRE)) != NULL) {
+    if (wc->hash == hash && strcmp(wc->word, word) == 0) {
+      break;
+    }
+    i = (i + 1) & mask;
+  }
+  return &table->slots[i];
+}
+
+/*
+ * Returns the entry of TABLE for WORD, or NULL. Safe without the stripe lock:
+ * it hands back the entry it compared, never a slot that a racing insert may
+ * fill with some other word.
+ */
+static word_count_t* lookup(struct stripe_table* table, const char* word, unsigned int hash) {
+  size_t mask = table->capacity - 1;
+  size_t i = hash & mask;
+  word_count_t* wc;
+
+  while ((wc = __atomic_load_n(&table->slots[i], __ATOMIC_ACQUIRE)) != NULL) {
+    if (wc->hash == hash && strcmp(wc->word, word) == 0) {
+      return wc;
+    }
+    i = (i + 1) & mask;
+  }
+  return NULL;
+}
+
+static void lock_stripe(word_count_list_t* wclist, word_stripe_t* stripe) {
+  if (wclist->shared) {
+    pthread_mutex_lock(&stripe->lock);
+  }
+}
+
+static void unlock_stripe(word_count_list_t* wclist, word_stripe_t* stripe) {
+  if (wclist->shared) {
+    pthread_mutex_unlock(&stripe->lock);
+  }
+}
+
+/* Publishes a table twice the size. Caller holds the stripe lock. */
+static bool grow(word_stripe_t* stripe) {
+  struct stripe_table* old = stripe->table;
+  struct stripe_table* table = new_table(2 * old->capacity);
+
+  if (table == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < old->capacity; i++) {
+    if (old->slots[i] != NULL) {
+      *probe(table, old->slots[i]->word, old->slots[i]->hash) = old->slots[i];
+    }
+  }
+  /* Readers may still be probing OLD, so it lives until free_words. */
+  table->retired = old;
+  __atomic_store_n(&stripe->table, table, __ATOMIC_RELEASE);
+  return true;
+}
+
+/*
+ * Adds WC's count to the entry for its word, or makes WC that entry. Returns
+ * the entry, or NULL if memory ran out.
+ */
+static word_count_t* insert(word_count_list_t* wclist, word_count_t* wc) {
+  word_stripe_t* stripe = stripe_of(wclist, wc->hash);
+  word_count_t** slot;
+  word_count_t* found;
+
+  lock_stripe(wclist, stripe);
+  slot = probe(stripe->table, wc->word, wc->hash);
+  found = *slot;
+  if (found != NULL) {
+    __atomic_fetch_add(&found->count, wc->count, __ATOMIC_RELAXED);
+  } else if (4 * (stripe->size + 1) <= 3 * stripe->table->capacity || grow(stripe)) {
+    slot = probe(stripe->table, wc->word, wc->hash);
+    __atomic_store_n(slot, wc, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&stripe->size, 1, __ATOMIC_RELAXED);
+    found = wc;
+  }
+  unlock_stripe(wclist, stripe);
+  return found;
+}
+
+/*
+ * Puts every entry of TABLE back within reach of probe() after other entries
+ * were taken out from between it and its home slot. Each move brings an entry
+ * closer to home, so the passes stop. Only for a table no one else can see.
+ */
+static void reseat(struct stripe_table* table) {
+  bool moved;
+
+  do {
+    moved = false;
+    for (size_t i = 0; i < table->capacity; i++) {
+      word_count_t* wc = table->slots[i];
+      word_count_t** slot;
+
+      if (wc == NULL) {
+        continue;
+      }
+      slot = probe(table, wc->word, wc->hash);
+      if (*slot == NULL) {
+        *slot = wc;
+        table->slots[i] = NULL;
+        moved = true;
+      }
+    }
+  } while (moved);
+}
+
+void init_words(word_count_list_t* wclist) {
+  for (int i = 0; i < WORD_STRIPES; i++) {
+    pthread_mutex_init(&wclist->stripes[i].lock, NULL);
+    wclist->stripes[i].table = new_table(INITIAL_CAPACITY);
+    wclist->stripes[i].size = 0;
+  }
+  wclist->order = NULL;
+  wclist->order_len = 0;
+  wclist->shared = true;
+}
+
+void init_private_words(word_count_list_t* wclist) {
+  init_words(wclist);
+  wclist->shared = false;
+}
+
+size_t len_words(word_count_list_t* wclist) {
+  size_t len = 0;
+
+  for (int i = 0; i < WORD_STRIPES; i++) {
+    len += __atomic_load_n(&wclist->stripes[i].size, __ATOMIC_RELAXED);
+  }
+  return len;
+}
+
+word_count_t* find_word(word_count_list_t* wclist, char* word) {
+  unsigned int hash;
+  struct stripe_table* table;
+
+  if (wclist == NULL) {
+    return NULL;
+  }
+  hash = hash_word(word);
+  table = __atomic_load_n(&stripe_of(wclist, hash)->table, __ATOMIC_ACQUIRE);
+  return table != NULL ? lookup(table, word, hash) : NULL;
+}
+
+word_count_t* add_word(word_count_list_t* wclist, char* word) {
+  unsigned int hash;
+  word_count_t* wc;
+
+  if (wclist == NULL) {
+    return NULL;
+  }
+  hash = hash_word(word);
+
+  /* Fast path: the word is already there, so just count it. */
+  struct stripe_table* table = __atomic_load_n(&stripe_of(wclist, hash)->table, __ATOMIC_ACQUIRE);
+  if (table == NULL) {
+    return NULL;
+  }
+  wc = lookup(table, word, hash);
+  if (wc != NULL) {
+    __atomic_fetch_add(&wc->count, 1, __ATOMIC_RELAXED);
+    free(word);
+    return wc;
+  }
+
+  wc = malloc(sizeof(word_count_t));
+  if (wc == NULL) {
+    return NULL;
+  }
+  wc->word = word;
+  wc->count = 1;
+  wc->hash = hash;
+
+  word_count_t* found = insert(wclist, wc);
+  if (found != wc) {
+    /* Someone else inserted the word first, or memory ran out. */
+    free(wc);
+    if (found != NULL) {
+      free(word);
+    }
+  }
+  return found;
+}
+
+bool merge_words(word_count_list_t* dst, word_count_list_t* src) {
+  bool merged = true;
+
+  if (dst == NULL || src == NULL) {
+    return false;
+  }
+
+  for (int i = 0; i < WORD_STRIPES; i++) {
+    struct stripe_table* table = src->stripes[i].table;
+    size_t kept = 0;
+
+    for (size_t j = 0; table != NULL && j < table->capacity; j++) {
+      word_count_t* wc = table->slots[j];
+      word_count_t* found;
+
+      if (wc == NULL) {
+        continue;
+      }
+      found = insert(dst, wc);
+      if (found == NULL) {
+        /* Out of memory; the word stays where it is. */
+        kept++;
+        merged = false;
+        continue;
+      }
+      table->slots[j] = NULL;
+      if (found != wc) {
+        free(wc->word);
+        free(wc);
+      }
+    }
+    src->stripes[i].size = kept;
+    if (kept > 0) {
+      reseat(table);
+    }
+  }
+  free(src->order);
+  src->order = NULL;
+  free(dst->order);
+  dst->order = NULL;
+  return merged;
+}
+
+void free_words(word_count_list_t* wclist) {
+  for (int i = 0; i < WORD_STRIPES; i++) {
+    struct stripe_table* table = wclist->stripes[i].table;
+
+    for (size_t j = 0; table != NULL && j < table->capacity; j++) {
+      if (table->slots[j] != NULL) {
+        free(table->slots[j]->word);
+        free(table->slots[j]);
+      }
+    }
+    while (table != NULL) {
+      struct stripe_table* retired = table->retired;
+      free(table);
+      table = retired;
+    }
+    wclist->stripes[i].table = NULL;
+    wclist->stripes[i].size = 0;
+  }
+  free(wclist->order);
+  wclist->order = NULL;
+}
+
+size_t wordcount_entries(word_count_list_t* wclist, word_count_t** out) {
+  size_t n = 0;
+
+  for (int i = 0; i < WORD_STRIPES; i++) {
+    struct stripe_table* table = wclist->stripes[i].table;
+
+    for (size_t j = 0; table != NULL && j < table->capacity; j++) {
+      if (table->slots[j] != NULL) {
+        out[n++] = table->slots[j];
+      }
+    }
+  }
+  return n;
+}
+
+void fprint_words(word_count_list_t* wclist, FILE* outfile) {
+  word_count_t** entries = wclist->order;
+  size_t n = wclist->order_len;
+
+  /* A sorted view that is missing words added since is no use. */
+  if (entries == NULL || n != len_words(wclist)) {
+    entries = malloc(len_words(wclist) * sizeof(word_count_t*));
+    if (entries == NULL) {
+      return;
+    }
+    n = wordcount_entries(wclist, entries);
+  }
+  for (size_t i = 0; i < n; i++) {
+    fprintf(outfile, "%i\t%s\n", entries[i]->count, entries[i]->word);
+  }
+  if (entries != wclist->order) {
+    free(entries);
+  }
+}
+
+void wordcount_sort(word_count_list_t* wclist, bool less(const word_count_t*, const word_count_t*)) {
+  if (wclist == NULL) {
+    return;
+  }
+  free(wclist->order);
+  wclist->order = malloc(len_words(wclist) * sizeof(word_count_t*));
+  if (wclist->order == NULL) {
+    return;
+  }
+
+  wclist->order_len = wordcount_entries(wclist, wclist->order);
+  if (less == less_count && sort_by_count(wclist->order, wclist->order_len)) {
+    return;
+  }
+  if (!sort_entries(wclist->order, wclist->order_len, less)) {
+    free(wclist->order);
+    wclist->order = NULL;
+  }
+}
@@ -0,0 +1,191 @@
+/*
+ * Implementation of the word_rank interface.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "word_rank.h"
+
+/* Bits of the count handled per radix sort pass. */
+#define RADIX_BITS 8
+#define RADIX (1 << RADIX_BITS)
+
+static int cmp_word(const void* a, const void* b) {
+  return strcmp((*(word_count_t* const*)a)->word, (*(word_count_t* const*)b)->word);
+}
+
+bool sort_by_count(word_count_t** arr, size_t n) {
+  word_count_t** tmp = malloc(n * sizeof(word_count_t*));
+  size_t hist[RADIX];
+
+  if (n > 0 && tmp == NULL) {
+    return false;
+  }
+
+  /* Stable LSD passes over the count, skipping digits every entry shares. */
+  for (unsigned shift = 0; shift < 8 * sizeof(int); shift += RADIX_BITS) {
+    size_t offset = 0;
+    bool skip = false;
+
+    memset(hist, 0, sizeof(hist));
+    for (size_t i = 0; i < n; i++) {
+      hist[((unsigned)arr[i]->count >> shift) & (RADIX - 1)]++;
+    }
+    for (size_t d = 0; d < RADIX; d++) {
+      size_t c = hist[d];
+      skip |= c == n;
+      hist[d] = offset;
+      offset += c;
+    }
+    if (skip) {
+      continue;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      tmp[hist[((unsigned)arr[i]->count >> shift) & (RADIX - 1)]++] = arr[i];
+    }
+    memcpy(arr, tmp, n * sizeof(word_count_t*));
+  }
+  free(tmp);
+
+  /* Words are distinct, so ordering each run of equal counts by word is all
+   * that is left of less_count. */
+  for (size_t i = 0, j; i < n; i = j) {
+    for (j = i + 1; j < n && arr[j]->count == arr[i]->count; j++) {
+    }
+    if (j - i > 1) {
+      qsort(arr + i, j - i, sizeof(word_count_t*), cmp_word);
+    }
+  }
+  return true;
+}
+
+/* Merge sort of N entries, using TMP as scratch space. */
+static void merge_sort(word_count_t** arr, word_count_t** tmp, size_t n,
+                       bool less(const word_count_t*, const word_count_t*)) {
+  size_t mid = n / 2, i = 0, j = mid, k = 0;
+
+  if (n < 2) {
+    return;
+  }
+  merge_sort(arr, tmp, mid, less);
+  merge_sort(arr + mid, tmp, n - mid, less);
+
+  while (i < mid && j < n) {
+    tmp[k++] = less(arr[j], arr[i]) ? arr[j++] : arr[i++];
+  }
+  while (i < mid) {
+    tmp[k++] = arr[i++];
+  }
+  memcpy(arr, tmp, k * sizeof(word_count_t*));
+}
+
+bool sort_list_by_count(struct list* list, size_t elem_offset) {
+  size_t n = list_size(list);
+  word_count_t** arr = malloc(n * sizeof(word_count_t*));
+  size_t i = 0;
+
+  if (n > 0 && arr == NULL) {
+    return false;
+  }
+  for (struct list_elem* e = list_begin(list); e != list_end(list); e = list_next(e)) {
+    arr[i++] = (word_count_t*)((char*)e - elem_offset);
+  }
+  if (!sort_by_count(arr, n)) {
+    free(arr);
+    return false;
+  }
+  list_init(list);
+  for (i = 0; i < n; i++) {
+    list_push_back(list, (struct list_elem*)((char*)arr[i] + elem_offset));
+  }
+  free(arr);
+  return true;
+}
+
+bool sort_entries(word_count_t** arr, size_t n, bool less(const word_count_t*, const word_count_t*)) {
+  word_count_t** tmp = malloc(n * sizeof(word_count_t*));
+
+  if (n > 0 && tmp == NULL) {
+    return false;
+  }
+  merge_sort(arr, tmp, n, less);
+  free(tmp);
+  return true;
+}
+
+/* Restores the heap property below slot I of the N-entry heap, least at the root. */
+static void sift_down(word_count_t** heap, size_t n, size_t i,
+                      bool less(const word_count_t*, const word_count_t*)) {
+  for (;;) {
+    size_t least = i, left = 2 * i + 1, right = 2 * i + 2;
+    word_count_t* swap;
+
+    if (left < n && less(heap[left], heap[least])) {
+      least = left;
+    }
+    if (right < n && less(heap[right], heap[least])) {
+      least = right;
+    }
+    if (least == i) {
+      return;
+    }
+    swap = heap[i];
+    heap[i] = heap[least];
+    heap[least] = swap;
+    i = least;
+  }
+}
+
+size_t select_top(word_count_t** arr, size_t n, size_t k,
+                  bool less(const word_count_t*, const word_count_t*)) {
+  word_count_t* swap;
+
+  if (k > n) {
+    k = n;
+  }
+  if (k == 0) {
+    return 0;
+  }
+
+  for (size_t i = k / 2; i-- > 0;) {
+    sift_down(arr, k, i, less);
+  }
+  /* The root is the least of the K kept so far; anything greater evicts it. */
+  for (size_t i = k; i < n; i++) {
+    if (less(arr[0], arr[i])) {
+      swap = arr[0];
+      arr[0] = arr[i];
+      arr[i] = swap;
+      sift_down(arr, k, 0, less);
+    }
+  }
+
+  /* Heapsort leaves the greatest first, so reverse into LESS order. */
+  for (size_t end = k - 1; end > 0; end--) {
+    swap = arr[0];
+    arr[0] = arr[end];
+    arr[end] = swap;
+    sift_down(arr, end, 0, less);
+  }
+  for (size_t i = 0, j = k - 1; i < j; i++, j--) {
+    swap = arr[i];
+    arr[i] = arr[j];
+    arr[j] = swap;
+  }
+  return k;
+}
@@ -0,0 +1,55 @@
+/*
+ * The word_rank interface orders arrays of word count entries. It only looks
+ * at the word and count fields, which every representation puts first, so it
+ * is compiled once and shared like word_helpers.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_RANK_H
+#define WORD_RANK_H
+
+#include "word_count.h"
+#include "list.h"
+
+/*
+ * Sorts the N entries of ARR into less_count order. A radix sort on the
+ * counts does most of the work, so only words with equal counts are compared
+ * as strings. Returns false, leaving ARR alone, if memory runs out.
+ */
+bool sort_by_count(word_count_t** arr, size_t n);
+
+/*
+ * Relinks LIST in less_count order, ranking its entries with sort_by_count
+ * rather than comparing counts one pair at a time. Each entry's list_elem lies
+ * ELEM_OFFSET bytes into it. Returns false, leaving LIST alone, if memory
+ * runs out.
+ */
+bool sort_list_by_count(struct list* list, size_t elem_offset);
+
+/* Stable merge sort of the N entries of ARR under LESS. Returns false if memory ran out. */
+bool sort_entries(word_count_t** arr, size_t n, bool less(const word_count_t*, const word_count_t*));
+
+/*
+ * Moves the K greatest of the N entries of ARR under LESS to its front, in
+ * LESS order, using a K-entry heap. Returns how many entries were moved,
+ * which is K or N, whichever is smaller.
+ */
+size_t select_top(word_count_t** arr, size_t n, size_t k,
+                  bool less(const word_count_t*, const word_count_t*));
+
+#endif /* WORD_RANK_H */
@@ -0,0 +1,191 @@
+/*
+ * Implementation of the word_scan interface.
+ *
+ * The scanner classifies its input 64 bytes at a time into a bitmask with one
+ * bit per letter, then hands out words by bit tricks on that mask: a word's
+ * first letter is the lowest set bit, and the byte after its last letter is
+ * the lowest clear bit above that. SSE2 builds the mask from four 16-byte
+ * compares and is always there on x86-64; AVX2 uses two 32-byte compares when
+ * the file is built with -mavx2. Defining WORD_SCAN_SCALAR, or building for
+ * another architecture, classifies a byte at a time instead.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+
+#include "word_scan.h"
+
+/* Words shorter than this are skipped, as in count_words. */
+#define MIN_WORD_LEN 2
+
+/* Bytes classified per step of the scanner. */
+#define BLOCK_SIZE 64
+
+/* ASCII only, so the result does not depend on the locale. */
+static int is_letter(char c) { return (unsigned char)((c | 0x20) - 'a') < 26; }
+
+#if !defined(WORD_SCAN_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define VECTOR_SIZE 32
+
+/* Bit i is set iff P[i] is an ASCII letter. */
+static uint64_t vector_mask(const char* p) {
+  __m256i folded = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi8(0x20));
+  /* Bytes >= 0x80 are negative, so they fail the first signed compare. */
+  __m256i ge_a = _mm256_cmpgt_epi8(folded, _mm256_set1_epi8('a' - 1));
+  __m256i gt_z = _mm256_cmpgt_epi8(folded, _mm256_set1_epi8('z'));
+  return (uint32_t)_mm256_movemask_epi8(_mm256_andnot_si256(gt_z, ge_a));
+}
+
+static void lower_vector(char* dst, const char* src) {
+  __m256i v = _mm256_loadu_si256((const __m256i*)src);
+  _mm256_storeu_si256((__m256i*)dst, _mm256_or_si256(v, _mm256_set1_epi8(0x20)));
+}
+
+#elif !defined(WORD_SCAN_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define VECTOR_SIZE 16
+
+/* Bit i is set iff P[i] is an ASCII letter. */
+static uint64_t vector_mask(const char* p) {
+  __m128i folded = _mm_or_si128(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8(0x20));
+  /* Bytes >= 0x80 are negative, so they fail the first signed compare. */
+  __m128i ge_a = _mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1));
+  __m128i gt_z = _mm_cmpgt_epi8(folded, _mm_set1_epi8('z'));
+  return (uint32_t)_mm_movemask_epi8(_mm_andnot_si128(gt_z, ge_a));
+}
+
+static void lower_vector(char* dst, const char* src) {
+  __m128i v = _mm_loadu_si128((const __m128i*)src);
+  _mm_storeu_si128((__m128i*)dst, _mm_or_si128(v, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/*
+ * Returns the letter mask of the N <= BLOCK_SIZE bytes at P. Bits at and
+ * above N are clear, so the end of the buffer looks like a non-letter.
+ */
+static uint64_t block_mask(const char* p, size_t n) {
+  uint64_t mask = 0;
+  size_t i = 0;
+
+#ifdef VECTOR_SIZE
+  if (n == BLOCK_SIZE) {
+    for (; i < BLOCK_SIZE; i += VECTOR_SIZE) {
+      mask |= vector_mask(p + i) << i;
+    }
+    return mask;
+  }
+#endif
+  for (; i < n; i++) {
+    mask |= (uint64_t)is_letter(p[i]) << i;
+  }
+  return mask;
+}
+
+/* Moves the scanner to the next block. Returns false at the end of the buffer. */
+static bool next_block(word_scanner_t* scanner) {
+  size_t base = scanner->base + BLOCK_SIZE;
+
+  if (base >= scanner->len) {
+    return false;
+  }
+  scanner->base = base;
+  scanner->mask = block_mask(scanner->buf + base, scanner->len - base < BLOCK_SIZE
+                                                      ? scanner->len - base
+                                                      : BLOCK_SIZE);
+  return true;
+}
+
+void scan_init(word_scanner_t* scanner, const char* buf, size_t len) {
+  scanner->buf = buf;
+  scanner->len = len;
+  scanner->base = 0;
+  scanner->mask = block_mask(buf, len < BLOCK_SIZE ? len : BLOCK_SIZE);
+}
+
+size_t scan_next(word_scanner_t* scanner, size_t* start) {
+  for (;;) {
+    size_t begin, end;
+    uint64_t rest;
+
+    while (scanner->mask == 0) {
+      if (!next_block(scanner)) {
+        return 0;
+      }
+    }
+    begin = scanner->base + __builtin_ctzll(scanner->mask);
+
+    /* Letters below BEGIN are gone from the mask, so its lowest clear bit at
+     * or above BEGIN is where the word stops. */
+    rest = ~scanner->mask & (~0ULL << (begin - scanner->base));
+    while (rest == 0) {
+      if (!next_block(scanner)) {
+        scanner->mask = 0;
+        break;
+      }
+      rest = ~scanner->mask;
+    }
+    if (rest == 0) {
+      end = scanner->len;
+    } else {
+      unsigned bit = __builtin_ctzll(rest);
+      end = scanner->base + bit;
+      scanner->mask &= ~0ULL << bit;
+    }
+
+    if (end - begin >= MIN_WORD_LEN) {
+      *start = begin;
+      return end - begin;
+    }
+  }
+}
+
+size_t word_boundary(const char* buf, size_t len, size_t off) {
+  if (off == 0) {
+    return 0;
+  }
+  while (off < len && is_letter(buf[off - 1]) && is_letter(buf[off])) {
+    off++;
+  }
+  return off < len ? off : len;
+}
+
+size_t word_tail(const char* buf, size_t len) {
+  size_t off = len;
+
+  while (off > 0 && is_letter(buf[off - 1])) {
+    off--;
+  }
+  return off;
+}
+
+void lower_word(char* dst, const char* word, size_t len) {
+  size_t i = 0;
+
+#ifdef VECTOR_SIZE
+  /* Every byte of a word is a letter, so setting bit 5 lowercases it. */
+  for (; i + VECTOR_SIZE <= len; i += VECTOR_SIZE) {
+    lower_vector(dst + i, word + i);
+  }
+#endif
+  for (; i < len; i++) {
+    dst[i] = word[i] | 0x20;
+  }
+  dst[len] = '\0';
+}
@@ -0,0 +1,64 @@
+/*
+ * The word_scan interface finds words in an in-memory buffer, using the same
+ * rules as count_words: a word is a run of ASCII letters, at least two long.
+ */
+
+/*
+ * Copyright © 2021 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_SCAN_H
+#define WORD_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Iterator over the words of a buffer. MASK has one bit per byte of the
+ * 64-byte block at BASE, set for the letters not yet handed out.
+ */
+typedef struct word_scanner {
+  const char* buf;
+  size_t len;
+  size_t base;
+  uint64_t mask;
+} word_scanner_t;
+
+/* Start scanning the LEN bytes at BUF. */
+void scan_init(word_scanner_t* scanner, const char* buf, size_t len);
+
+/*
+ * Finds the next word. Stores the offset of its first letter in *START and
+ * returns its length, or returns 0 once no words are left.
+ */
+size_t scan_next(word_scanner_t* scanner, size_t* start);
+
+/*
+ * Returns the first offset at or after OFF that is not in the middle of a
+ * word. Splitting a buffer at such offsets never cuts a word in two.
+ */
+size_t word_boundary(const char* buf, size_t len, size_t off);
+
+/*
+ * Returns the offset of the first letter of the word that runs to the end of
+ * BUF, or LEN if BUF does not end in a letter. When more input may follow,
+ * only BUF[0, word_tail) is safe to scan.
+ */
+size_t word_tail(const char* buf, size_t len);
+
+/* Copies the LEN bytes at WORD into DST, lowercased and NUL-terminated. */
+void lower_word(char* dst, const char* word, size_t len);
+
+#endif /* WORD_SCAN_H */
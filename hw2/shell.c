@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -7,6 +9,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
@@ -18,6 +21,15 @@
 #define BUF_SIZE 8192
 #define READ_WRITE_EXECUTE 0777
 #define NUM_SIGNALS 8
+#define PATH_CACHE_BUCKETS 64
+#define PARSE_CACHE_BUCKETS 256
+#define PARSE_CACHE_LIMIT 4096
+#define READ_BLOCK_SIZE 65536
+
+/* posix_spawn can hand the terminal to the child itself since glibc 2.35. */
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35))
+#define HAVE_SPAWN_TCSETPGRP 1
+#endif
 
 /* Whether the shell is connected to an actual terminal or not. */
 bool shell_is_interactive;
@@ -25,6 +37,9 @@ bool shell_is_interactive;
 /* File descriptor for the shell input */
 int shell_terminal;
 
+/* File descriptor commands are read from: the terminal, or a script given with -f */
+int shell_input = STDIN_FILENO;
+
 /* Terminal mode settings for the shell */
 struct termios shell_tmodes;
 
@@ -35,6 +50,9 @@ int cmd_exit(struct tokens* tokens);
 int cmd_help(struct tokens* tokens);
 int cmd_cd(struct tokens* tokens);
 int cmd_pwd(struct tokens* tokens);
+int cmd_hash(struct tokens* tokens);
+int cmd_wait(struct tokens* tokens);
+int cmd_parallel(struct tokens* tokens);
 
 /* Built-in command functions take token array (see parse.h) and return int */
 typedef int cmd_fun_t(struct tokens* tokens);
@@ -53,8 +71,87 @@ fun_desc_t cmd_table[] = {
         {cmd_exit, "exit", "exit the command shell"},
         {cmd_cd, "cd", "change the current directory"},
         {cmd_pwd, "pwd", "print the current directory"},
+        {cmd_hash, "hash", "list remembered command paths, or forget them with -r"},
+        {cmd_wait, "wait", "wait for every background job to finish"},
+        {cmd_parallel, "parallel", "run lines of a file or stdin as commands, N at a time (-j N)"},
 };
 
+/*
+ * Where each command name was last found on $PATH, so that running it again
+ * skips the directory search, as with bash's hash table. The table is only
+ * good for the $PATH it was filled under, saved in path_cache_env, and is
+ * emptied whenever $PATH differs from that.
+ */
+typedef struct path_entry {
+    char* name;
+    char* path;
+    unsigned int hits;
+    struct path_entry* next;
+} path_entry_t;
+
+path_entry_t* path_cache[PATH_CACHE_BUCKETS];
+char* path_cache_env;
+
+/*
+ * Tokenized lines of a script, keyed by their text, so a line that comes up
+ * again is not tokenized again. Only used when not interactive. Entries are
+ * kept until the shell exits; after PARSE_CACHE_LIMIT of them, new lines are
+ * tokenized as usual and freed after running.
+ */
+typedef struct parsed_line {
+    char* line;
+    struct tokens* tokens;
+    struct parsed_line* next;
+} parsed_line_t;
+
+parsed_line_t* parse_cache[PARSE_CACHE_BUCKETS];
+size_t parse_cache_size;
+
+/* Buffered reader handing out whole lines of any length from a file descriptor. */
+typedef struct line_reader {
+    int fd;
+    char* buf;
+    size_t cap;
+    size_t start;
+    size_t end;
+    bool eof;
+} line_reader_t;
+
+/* The reader for shell_input. parallel takes its lines from it too. */
+line_reader_t shell_reader;
+
+/*
+ * A job is the processes of one pipeline. Jobs stay on JOBS, oldest first,
+ * until the shell is done with them, and reap_children records their exit
+ * as SIGCHLD reports it. Foreground jobs are waited for at once; background
+ * jobs (a line ending in "&") are forgotten, and reported when interactive,
+ * at the next prompt. Jobs run by parallel write to the temporary files
+ * OUT_FD and ERR_FD, which are printed in one piece once the job is done.
+ */
+typedef struct job {
+    int id;
+    pid_t pgid;
+    pid_t* pids;
+    size_t num_pids;
+    size_t running;
+    int status;
+    bool foreground;
+    int out_fd;
+    int err_fd;
+    char* command;
+    struct job* next;
+} job_t;
+
+job_t* jobs;
+
+/* The shell's signal mask, less SIGCHLD, which is blocked except in wait_for_children. */
+sigset_t shell_sigmask;
+
+/* /dev/null, which jobs not in the foreground read instead of the shell's input. */
+int null_fd = -1;
+
+extern char** environ;
+
 /* Prints a helpful description for the given command */
 int cmd_help(unused struct tokens* tokens) {
     for (unsigned int i = 0; i < sizeof(cmd_table) / sizeof(fun_desc_t); i++)
@@ -102,6 +199,35 @@ int cmd_pwd(struct tokens* tokens) {
     return 1;
 }
 
+/* Forgets every remembered command path. */
+void path_cache_clear(void) {
+    for (int i = 0; i < PATH_CACHE_BUCKETS; ++i) {
+        while (path_cache[i] != NULL) {
+            path_entry_t* entry = path_cache[i];
+            path_cache[i] = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+        }
+    }
+}
+
+/* Lists remembered command paths, or forgets them all with -r, like bash's hash. */
+int cmd_hash(struct tokens* tokens) {
+    char* flag = tokens_get_token(tokens, 1);
+
+    if (flag != NULL && strcmp(flag, "-r") == 0) {
+        path_cache_clear();
+        return 1;
+    }
+    for (int i = 0; i < PATH_CACHE_BUCKETS; ++i) {
+        for (path_entry_t* entry = path_cache[i]; entry != NULL; entry = entry->next) {
+            fprintf(stdout, "%4u\t%s\n", entry->hits, entry->path);
+        }
+    }
+    return 1;
+}
+
 /* Looks up the built-in command, if it exists. */
 int lookup(char cmd[]) {
     for (unsigned int i = 0; i < sizeof(cmd_table) / sizeof(fun_desc_t); i++)
@@ -115,8 +241,8 @@ void init_shell() {
     /* Our shell is connected to standard input. */
     shell_terminal = STDIN_FILENO;
 
-    /* Check if we are running interactively */
-    shell_is_interactive = isatty(shell_terminal);
+    /* Check if we are running interactively. A script given with -f never is. */
+    shell_is_interactive = shell_input == shell_terminal && isatty(shell_terminal);
 
     if (shell_is_interactive) {
         /* If the shell is not currently in the foreground, we must pause the shell until it becomes a
@@ -144,225 +270,742 @@ void set_signals(void* val) {
     }
 }
 
-/* Returns (pass by reference) the count and start of the second partition (zero if there is only one partition). */
-void count_parts(char* input, int* count, int* partition_index) {
-    const char DELIMITER = '|';
+/* Returns true if the path is absolute. */
+bool is_absolute_path(char* curr_path) {
+    /* Like other shells, any name with a slash in it is used as it is. */
+    return strchr(curr_path, '/') != NULL;
+}
 
-    for (*count = 0, *partition_index = 0; input[*count] != '\0'; *count += 1) {
-        if (input[*count] == DELIMITER) {
-            *partition_index = *count;
-            break;
-        }
+/* FNV-1a hash of a string, for the path and parse caches. */
+unsigned int hash_string(const char* str) {
+    unsigned int hash = 2166136261u;
+
+    for (; *str != '\0'; ++str) {
+        hash = (hash ^ (unsigned char) *str) * 16777619u;
     }
+    return hash;
+}
+
+/* Returns the bucket of the path cache that NAME hashes to. */
+path_entry_t** path_cache_bucket(const char* name) {
+    return &path_cache[hash_string(name) % PATH_CACHE_BUCKETS];
 }
 
-/* Fills array ARR with tokens. */
-void tokens_to_arr(char* arr[], struct tokens* tokens, size_t token_length) {
-    for (int i = 0; i < token_length; ++i) {
-        arr[i] = tokens_get_token(tokens, i);
+/* Drops NAME from the path cache, for when the file it was found at is gone. */
+void path_cache_forget(const char* name) {
+    for (path_entry_t** link = path_cache_bucket(name); *link != NULL; link = &(*link)->next) {
+        if (strcmp((*link)->name, name) == 0) {
+            path_entry_t* entry = *link;
+            *link = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+            return;
+        }
     }
-    arr[token_length] = NULL;
 }
 
-/* Returns true if the path is absolute. */
-bool is_absolute_path(char* curr_path) {
-    for (int i = 0; i < sizeof(curr_path); ++i) {
-        if (curr_path[i] == '/') {
-            return true;
+/* Searches each directory of $PATH for an executable NAME. Returns a malloc'd path, or NULL. */
+char* search_path(const char* name) {
+    const char* dirs = getenv("PATH");
+    size_t name_len = strlen(name);
+
+    for (const char* dir = dirs; dir != NULL; dir = strchr(dir, ':') ? strchr(dir, ':') + 1 : NULL) {
+        size_t dir_len = strchr(dir, ':') ? (size_t) (strchr(dir, ':') - dir) : strlen(dir);
+        char* candidate = malloc(dir_len + name_len + 2);
+
+        if (candidate == NULL) {
+            return NULL;
+        }
+        /* An empty entry means the current directory. */
+        if (dir_len == 0) {
+            strcpy(candidate, name);
+        } else {
+            memcpy(candidate, dir, dir_len);
+            candidate[dir_len] = '/';
+            strcpy(candidate + dir_len + 1, name);
+        }
+        if (access(candidate, X_OK) == 0) {
+            return candidate;
         }
+        free(candidate);
     }
-    return false;
+    return NULL;
 }
 
-/* Finds possible directories for a given relative path. */
+/*
+ * Finds the program a relative command name refers to, through the path
+ * cache. Returns a path owned by the cache, or NULL if there is no such
+ * program on $PATH.
+ */
 char* find_potential_path(char* relative_path) {
-    char curr_env[BUF_SIZE / 8];
-    const char DELIMITER = ':';
-    struct tokens* tokenized_paths;
-    size_t num_paths;
+    const char* env = getenv("PATH");
+    path_entry_t** bucket;
 
     if (relative_path == NULL) {
         return NULL;
     }
 
-    strcpy(curr_env, getenv("PATH"));
-    /* Removing : and replacing it with spaces. This prepares input for tokenization. */
-    for (int i = 0; i < sizeof(curr_env)/sizeof(char); ++i) {
-        if (curr_env[i] == DELIMITER) {
-            curr_env[i] = ' ';
+    if (env == NULL) {
+        env = "";
+    }
+    if (path_cache_env == NULL || strcmp(path_cache_env, env) != 0) {
+        path_cache_clear();
+        free(path_cache_env);
+        path_cache_env = strdup(env);
+    }
+
+    bucket = path_cache_bucket(relative_path);
+    for (path_entry_t* entry = *bucket; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->name, relative_path) == 0) {
+            entry->hits++;
+            return entry->path;
         }
     }
-    tokenized_paths = tokenize(curr_env);
-    num_paths = tokens_get_length(tokenized_paths);
 
-    for (int i = 0; i < num_paths; ++i) {
-        char temp_delimiter[] = {'/', '\0'};
-        char* temp_path = strcat(tokens_get_token(tokenized_paths, i), strcat(temp_delimiter, relative_path));
-        if (access(temp_path, F_OK) != -1) {
-            return temp_path;
+    char* found = search_path(relative_path);
+    path_entry_t* entry = found != NULL ? malloc(sizeof(path_entry_t)) : NULL;
+    if (entry == NULL || (entry->name = strdup(relative_path)) == NULL) {
+        free(entry);
+        free(found);
+        return NULL;
+    }
+    entry->path = found;
+    entry->hits = 1;
+    entry->next = *bucket;
+    *bucket = entry;
+    return found;
+}
+
+/* Only there to wake sigsuspend; reap_children does the work. */
+void on_sigchld(unused int sig) {}
+
+/* Records the exit of every child that has exited, without blocking. */
+void reap_children(void) {
+    pid_t process_ID;
+    int status;
+
+    while ((process_ID = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (job_t* job = jobs; job != NULL; job = job->next) {
+            for (size_t i = 0; i < job->num_pids; ++i) {
+                if (job->pids[i] == process_ID) {
+                    job->pids[i] = 0;
+                    job->running--;
+                    /* A pipeline's status is that of its last stage. */
+                    if (i == job->num_pids - 1) {
+                        job->status = status;
+                    }
+                }
+            }
         }
     }
+}
 
-    exit(1);
+/* Sleeps until a child exits, then reaps. With SIGCHLD blocked everywhere else, none is missed. */
+void wait_for_children(void) {
+    sigsuspend(&shell_sigmask);
+    reap_children();
 }
 
-/* Processing '>' and '<' redirections, if any. */
-int redirections_handler(char* program_args[]) {
-    char temp_in_buf[BUF_SIZE / 64];
-    char temp_out_buf[BUF_SIZE / 64];
-    int file_desc;
+/* Unlinks JOB from the job list and frees it. */
+void remove_job(job_t* job) {
+    for (job_t** link = &jobs; *link != NULL; link = &(*link)->next) {
+        if (*link == job) {
+            *link = job->next;
+            break;
+        }
+    }
+    if (job->out_fd >= 0) {
+        close(job->out_fd);
+    }
+    if (job->err_fd >= 0) {
+        close(job->err_fd);
+    }
+    free(job->command);
+    free(job->pids);
+    free(job);
+}
 
+/*
+ * Starts one command straight from the shell with posix_spawn, which glibc
+ * implements with a vfork-style clone, so nothing of the shell is copied.
+ * The command reads IN_FD and writes OUT_FD instead of stdin and stdout
+ * unless they are -1, and JOB's ERR_FD instead of stderr. Its own < and >
+ * redirections, which end its arguments, apply on top of those.
+ * PROGRAM_ARGS is handed to the child as it is, except that the first
+ * redirection is NULL for the length of the call. When
+ * interactive, it joins JOB's process group, or starts it, gets default
+ * signal handlers, and takes the terminal if JOB is in the foreground.
+ * Errors starting it go where its stderr would have. Returns the child's
+ * pid, or -1 if it could not be started.
+ */
+pid_t spawn_program(char* program_args[], int in_fd, int out_fd, job_t* job) {
+    char* curr_path = program_args[0], *final_path;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t defaults;
+    pid_t process_ID = -1;
+    int err, args_end = -1;
+    int diag_fd = job->err_fd >= 0 ? job->err_fd : STDERR_FILENO;
+
+    posix_spawn_file_actions_init(&actions);
+#ifdef HAVE_SPAWN_TCSETPGRP
+    /* Before the dups below, while the terminal is still on shell_terminal. */
+    if (shell_is_interactive && job->foreground && job->pgid == 0) {
+        posix_spawn_file_actions_addtcsetpgrp_np(&actions, shell_terminal);
+    }
+#endif
+    if (in_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    }
+    if (out_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    }
+    if (job->err_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, job->err_fd, STDERR_FILENO);
+    }
     for (int i = 0; program_args[i] != NULL; ++i) {
-        if (strcmp(">", program_args[i]) == 0) {
-            strcpy(temp_out_buf, program_args[i + 1]);
-            program_args[i] = NULL;
-            file_desc = creat(temp_out_buf, READ_WRITE_EXECUTE);
-            if (file_desc < 0) {
-                perror("Error Opening Output File");
-                return -1;
+        bool redirection = program_args[i + 1] != NULL;
+        if (redirection && strcmp(">", program_args[i]) == 0) {
+            posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, program_args[i + 1],
+                                             O_WRONLY | O_CREAT | O_TRUNC, READ_WRITE_EXECUTE);
+        } else if (redirection && strcmp("<", program_args[i]) == 0) {
+            posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, program_args[i + 1], O_RDONLY, 0);
+        } else {
+            continue;
+        }
+        if (args_end < 0) {
+            args_end = i;
+        }
+        ++i;
+    }
+    char* first_redirection = args_end >= 0 ? program_args[args_end] : NULL;
+    if (args_end >= 0) {
+        program_args[args_end] = NULL;
+    }
+
+    sigemptyset(&defaults);
+    for (int i = 0; i < NUM_SIGNALS; ++i) {
+        if (signals[i] != SIGKILL) {
+            sigaddset(&defaults, signals[i]);
+        }
+    }
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &shell_sigmask);
+    /* Without job control the shell ignores no signals, and children stay in
+     * its process group so that killing a batch run kills them too. */
+    if (shell_is_interactive) {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF);
+        posix_spawnattr_setpgroup(&attr, job->pgid);
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+    } else {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    }
+
+    final_path = is_absolute_path(curr_path) ? curr_path : find_potential_path(curr_path);
+    if (final_path == NULL) {
+        dprintf(diag_fd, "%s: command not found\n", curr_path);
+    } else {
+        err = posix_spawn(&process_ID, final_path, &actions, &attr, program_args, environ);
+        if (err == ENOENT && final_path != curr_path && access(final_path, X_OK) != 0) {
+            /* The remembered program is gone; look for it again. */
+            path_cache_forget(curr_path);
+            final_path = find_potential_path(curr_path);
+            err = final_path != NULL ? posix_spawn(&process_ID, final_path, &actions, &attr, program_args, environ)
+                                     : ENOENT;
+        }
+        if (err != 0) {
+            dprintf(diag_fd, "%s: %s\n", curr_path, strerror(err));
+            process_ID = -1;
+        } else if (shell_is_interactive) {
+            /* Whichever of us gets here first sets up the process group. */
+            setpgid(process_ID, job->pgid != 0 ? job->pgid : process_ID);
+            if (job->foreground) {
+                tcsetpgrp(shell_terminal, job->pgid != 0 ? job->pgid : process_ID);
             }
-            dup2(file_desc, STDOUT_FILENO);
-            close(file_desc);
-
-        } else if (strcmp("<", program_args[i]) == 0) {
-            strcpy(temp_in_buf, program_args[i + 1]);
-            program_args[i] = NULL;
-            file_desc = open(temp_in_buf, O_RDONLY, 0);
-            if (file_desc < 0) {
-                perror("Error Opening Input File");
-                return -1;
+        }
+    }
+
+    /* posix_spawn is done with the arguments once it returns. */
+    if (args_end >= 0) {
+        program_args[args_end] = first_redirection;
+    }
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return process_ID;
+}
+
+/*
+ * Starts the pipeline in the first INPUT_LEN words of TOKENS as a new job,
+ * whose last stage writes to OUT_FD and every stage to ERR_FD unless they
+ * are -1. The job owns those descriptors from here on. The line is split
+ * into stages at "|" words once, and each stage is spawned from the shell
+ * into the process group of the first, so a long pipeline costs one spawn
+ * per stage and nothing more. Each pipe is made just before the stage that
+ * writes to it, and the shell closes its copy of each end once the stage
+ * using it has started, so only the ends the next spawn needs stay open
+ * however long the pipeline is. Pipe ends are close-on-exec, which keeps each child from
+ * holding the others open.
+ * Returns the job, or NULL if none of it could be started and its output
+ * is not captured.
+ */
+job_t* start_job(struct tokens* tokens, size_t input_len, bool foreground, int out_fd, int err_fd) {
+    char** words = tokens_get_argv(tokens);
+    size_t num_stages = 1, command_len = 0;
+    job_t* job = calloc(1, sizeof(job_t));
+
+    if (job == NULL) {
+        close(out_fd);
+        close(err_fd);
+        return NULL;
+    }
+    job->foreground = foreground;
+    job->out_fd = out_fd;
+    job->err_fd = err_fd;
+
+    for (size_t i = 0; i < input_len; ++i) {
+        command_len += strlen(words[i]) + 1;
+        if (strcmp(words[i], "|") == 0) {
+            ++num_stages;
+            if (i == 0 || i + 1 == input_len || strcmp(words[i - 1], "|") == 0) {
+                fprintf(stderr, "syntax error near '|'\n");
+                remove_job(job);
+                return NULL;
             }
-            dup2(file_desc, STDIN_FILENO);
-            close(file_desc);
         }
     }
-    return 0;
+
+    /* The command as typed, give or take quoting, for job reports. */
+    job->command = malloc(command_len + 1);
+    job->pids = calloc(num_stages, sizeof(pid_t));
+    if (job->command == NULL || job->pids == NULL) {
+        remove_job(job);
+        return NULL;
+    }
+    job->command[0] = '\0';
+    for (size_t i = 0; i < input_len; ++i) {
+        strcat(strcat(job->command, words[i]), i + 1 < input_len ? " " : "");
+    }
+
+    /*
+     * The stages are cut out of the token array itself by putting NULLs
+     * where the "|" words (and a trailing "&") are, and those are put back
+     * once every stage has started, since cached tokens get run again.
+     */
+    char** stages[num_stages];
+    char* cut_words[num_stages + 1];
+    cut_words[num_stages] = words[input_len];
+    words[input_len] = NULL;
+    stages[0] = words;
+    for (size_t i = 0, stage = 1; i < input_len; ++i) {
+        if (strcmp(words[i], "|") == 0) {
+            cut_words[stage] = words[i];
+            words[i] = NULL;
+            stages[stage++] = &words[i + 1];
+        }
+    }
+
+    /* Only the foreground job may read what the shell reads. */
+    if (!foreground && null_fd < 0) {
+        null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    int in_fd = foreground ? -1 : null_fd;
+    for (; job->num_pids < num_stages; ++job->num_pids) {
+        int pipe_file_desc[2] = {-1, out_fd};
+        size_t stage = job->num_pids;
+
+        if (stage + 1 < num_stages && pipe2(pipe_file_desc, O_CLOEXEC) < 0) {
+            perror("Pipe Creation Failed");
+            break;
+        }
+        job->pids[stage] = spawn_program(stages[stage], in_fd, pipe_file_desc[1], job);
+        if (in_fd >= 0 && in_fd != null_fd) {
+            close(in_fd);
+        }
+        if (stage + 1 < num_stages) {
+            close(pipe_file_desc[1]);
+        }
+        in_fd = pipe_file_desc[0];
+        if (job->pids[stage] > 0) {
+            job->running++;
+            if (job->pgid == 0) {
+                job->pgid = job->pids[stage];
+            }
+        } else {
+            job->pids[stage] = 0;
+        }
+    }
+    if (in_fd >= 0 && in_fd != null_fd) {
+        close(in_fd);
+    }
+    for (size_t stage = 1; stage < num_stages; ++stage) {
+        stages[stage][-1] = cut_words[stage];
+    }
+    words[input_len] = cut_words[num_stages];
+
+    /* A job whose output is captured stays listed even if nothing started,
+     * so that its errors come out in turn with the rest of its output. */
+    if (job->running == 0 && job->out_fd < 0) {
+        remove_job(job);
+        return NULL;
+    }
+    /* Append, numbering jobs from 1 up while any are left. */
+    job_t** link = &jobs;
+    job->id = 1;
+    while (*link != NULL) {
+        job->id = (*link)->id + 1;
+        link = &(*link)->next;
+    }
+    *link = job;
+    return job;
 }
 
-/* Executes single command. */
-int exec_single_program(char* input) {
-    char* curr_path, *final_path;
-    int input_len, ret_val;
-    struct tokens* tks;
+/* Waits for every process of JOB, forgets it, and returns the status of its last stage. */
+int wait_for_job(job_t* job) {
+    while (job->running > 0) {
+        wait_for_children();
+    }
+    int status = job->status;
+    remove_job(job);
+    return status;
+}
 
-    /* Handling signals */
-    setpgid(getpid(), getpid());
-    set_signals(SIG_DFL);
+/* Forgets finished background jobs, telling the user about them when interactive. */
+void report_jobs(void) {
+    reap_children();
+    for (job_t* job = jobs, *next; job != NULL; job = next) {
+        next = job->next;
+        if (job->running == 0 && !job->foreground && job->out_fd < 0) {
+            if (shell_is_interactive) {
+                fprintf(stdout, "[%d] Done\t%s\n", job->id, job->command);
+            }
+            remove_job(job);
+        }
+    }
+}
 
-    tks = tokenize(input);
-    input_len = tokens_get_length(tks);
-    curr_path = tokens_get_token(tks, 0);
+/* Copies what was written to the temporary file FD to TO_FD. */
+void copy_output(int fd, int to_fd) {
+    char buf[BUF_SIZE];
+    ssize_t n;
+
+    lseek(fd, 0, SEEK_SET);
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t done = 0, w; done < n; done += w) {
+            w = write(to_fd, buf + done, n - done);
+            if (w < 0) {
+                return;
+            }
+        }
+    }
+}
 
-    char* program_args[input_len + 1];
-    tokens_to_arr(program_args, tks, input_len);
-    final_path = (is_absolute_path(curr_path)) ? curr_path : find_potential_path(curr_path);
+/* Prints and forgets the finished jobs of parallel. Returns how many there were. */
+size_t print_finished_jobs(void) {
+    size_t finished = 0;
+
+    fflush(stdout);
+    for (job_t* job = jobs, *next; job != NULL; job = next) {
+        next = job->next;
+        if (job->running == 0 && job->out_fd >= 0) {
+            copy_output(job->out_fd, STDOUT_FILENO);
+            copy_output(job->err_fd, STDERR_FILENO);
+            remove_job(job);
+            ++finished;
+        }
+    }
+    return finished;
+}
 
-    ret_val = redirections_handler(program_args);
-    if (ret_val != 0) {
-        return ret_val;
+/* Waits for every background job to finish. */
+int cmd_wait(unused struct tokens* tokens) {
+    for (;;) {
+        bool running = false;
+        for (job_t* job = jobs; job != NULL; job = job->next) {
+            running |= job->running > 0;
+        }
+        if (!running) {
+            break;
+        }
+        wait_for_children();
     }
+    report_jobs();
+    return 1;
+}
+
+/* Opens an unnamed temporary file for the output of a parallel job. */
+int open_capture(void) {
+    const char* dir = getenv("TMPDIR");
+    char path[BUF_SIZE / 8];
 
-    execv(final_path, program_args);
-    return 0;
+    snprintf(path, sizeof(path), "%s/shell-job-XXXXXX", dir != NULL ? dir : "/tmp");
+    int fd = mkostemp(path, O_CLOEXEC);
+    if (fd >= 0) {
+        unlink(path);
+    }
+    return fd;
 }
 
-/* Runs programs mentioned in the given input. */
-int exec_programs(char* input) {
-    int count, partition_index;
-    int pipe_file_desc[2];
-    char first_part[BUF_SIZE / 2];
-    char other_parts[BUF_SIZE];
-    char* offset_input;
-    pid_t process_ID;
+/*
+ * Returns the next line of input without its newline, or NULL at the end.
+ * Input is read READ_BLOCK_SIZE bytes at a time, and the line stays valid
+ * until the next call.
+ */
+char* read_line(line_reader_t* reader) {
+    for (;;) {
+        char* line = reader->buf + reader->start;
+        char* newline = reader->end > reader->start ? memchr(line, '\n', reader->end - reader->start) : NULL;
+
+        if (newline != NULL) {
+            *newline = '\0';
+            reader->start = newline + 1 - reader->buf;
+            return line;
+        }
+        if (reader->eof) {
+            if (reader->start == reader->end) {
+                return NULL;
+            }
+            /* The last line has no newline; read() left room for its NUL. */
+            reader->buf[reader->end] = '\0';
+            reader->start = reader->end;
+            return line;
+        }
 
-    if (input == NULL) {
-        return -1;
+        /* Keep the partial line and make room for another block after it. */
+        if (reader->start > 0) {
+            memmove(reader->buf, line, reader->end - reader->start);
+        }
+        reader->end -= reader->start;
+        reader->start = 0;
+        if (reader->cap - reader->end <= READ_BLOCK_SIZE) {
+            size_t cap = reader->cap * 2 > reader->end + READ_BLOCK_SIZE + 1 ? reader->cap * 2
+                                                                               : reader->end + READ_BLOCK_SIZE + 1;
+            char* bigger = realloc(reader->buf, cap);
+            if (bigger == NULL) {
+                return NULL;
+            }
+            reader->buf = bigger;
+            reader->cap = cap;
+        }
+
+        ssize_t n = read(reader->fd, reader->buf + reader->end, reader->cap - reader->end - 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            reader->eof = true;
+        } else {
+            reader->end += n;
+        }
     }
-    count_parts(input, &count, &partition_index);
+}
 
-    if (partition_index) {
-        if (pipe(pipe_file_desc) < 0) {
-            perror("Pipe Creation Failed");
-            return -1;
+/*
+ * Tokenizes LINE through the parse cache. Sets *CACHED to whether the
+ * tokens belong to the cache, in which case the caller must not free them.
+ */
+struct tokens* parse_line(const char* line, bool* cached) {
+    parsed_line_t** bucket = &parse_cache[hash_string(line) % PARSE_CACHE_BUCKETS];
+    parsed_line_t* entry;
+
+    for (entry = *bucket; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->line, line) == 0) {
+            *cached = true;
+            return entry->tokens;
+        }
+    }
+
+    struct tokens* tokens = tokenize(line);
+    *cached = false;
+    if (parse_cache_size < PARSE_CACHE_LIMIT && (entry = malloc(sizeof(parsed_line_t))) != NULL) {
+        entry->line = strdup(line);
+        if (entry->line == NULL) {
+            free(entry);
+            return tokens;
         }
+        entry->tokens = tokens;
+        entry->next = *bucket;
+        *bucket = entry;
+        parse_cache_size++;
+        *cached = true;
+    }
+    return tokens;
+}
 
-        process_ID = fork();
-        if (process_ID > 0) {
-            close(pipe_file_desc[1]);
-            dup2(pipe_file_desc[0], STDIN_FILENO);
-            /* Copy the rest of input to buffer calculating the location of next token. We assume there is always spaces
-             * to each side of '|'. */
-            offset_input = 2 + input + count;
-            strcpy(other_parts, offset_input);
-            return exec_programs(other_parts);
-
-        } else if (process_ID == 0) {
-            close(pipe_file_desc[0]);
-            dup2(pipe_file_desc[1], STDOUT_FILENO);
-
-            /* Copying the first token. */
-            strncpy(first_part, input, partition_index - 1);
-            first_part[partition_index - 1] = '\0';
-            return exec_single_program(first_part);
+/*
+ * parallel [-j N] [FILE] runs each line of FILE, or of standard input, as a
+ * command, keeping up to N of them (one per processor by default) running
+ * at once. A command's output is held back until it is done and then
+ * printed whole, in the order the commands finish, so the output of two
+ * commands never interleaves. When the shell itself reads standard input,
+ * parallel runs the rest of it.
+ */
+int cmd_parallel(struct tokens* tokens) {
+    size_t num_args = tokens_get_length(tokens);
+    long slots = sysconf(_SC_NPROCESSORS_ONLN);
+    char* path = NULL;
+
+    for (size_t i = 1; i < num_args; ++i) {
+        char* arg = tokens_get_token(tokens, i);
+        if (strcmp(arg, "-j") == 0 && i + 1 < num_args && atoi(tokens_get_token(tokens, i + 1)) > 0) {
+            slots = atoi(tokens_get_token(tokens, ++i));
+        } else if (path == NULL && arg[0] != '-') {
+            path = arg;
         } else {
-            perror("Fork Failed");
+            fprintf(stderr, "usage: parallel [-j N] [FILE]\n");
             return -1;
         }
-    } else {
-        return exec_single_program(input);
     }
+    if (slots < 1) {
+        slots = 1;
+    }
+
+    line_reader_t file_reader = {STDIN_FILENO, NULL, 0, 0, 0, false};
+    line_reader_t* reader = &file_reader;
+    if (path != NULL) {
+        file_reader.fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (file_reader.fd < 0) {
+            perror(path);
+            return -1;
+        }
+    } else if (shell_input == STDIN_FILENO) {
+        reader = &shell_reader;
+    }
+
+    long running = 0;
+    char* line;
+    while ((line = read_line(reader)) != NULL) {
+        struct tokens* command = tokenize(line);
+
+        if (tokens_get_length(command) > 0) {
+            reap_children();
+            running -= print_finished_jobs();
+            while (running >= slots) {
+                wait_for_children();
+                running -= print_finished_jobs();
+            }
+
+            int out_fd = open_capture(), err_fd = open_capture();
+            if (out_fd < 0 || err_fd < 0) {
+                perror("parallel: temporary file");
+                close(out_fd);
+                close(err_fd);
+                tokens_destroy(command);
+                break;
+            }
+            if (start_job(command, tokens_get_length(command), false, out_fd, err_fd) != NULL) {
+                ++running;
+            }
+        }
+        tokens_destroy(command);
+    }
+    /* Jobs that started nothing are done already, and no child will wake us for them. */
+    running -= print_finished_jobs();
+    while (running > 0) {
+        wait_for_children();
+        running -= print_finished_jobs();
+    }
+
+    if (file_reader.fd > STDIN_FILENO) {
+        close(file_reader.fd);
+    }
+    free(file_reader.buf);
+    return 1;
 }
 
-int main(unused int argc, unused char* argv[]) {
-    int status;
-    pid_t process_ID;
+int main(int argc, char* argv[]) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:")) != -1) {
+        if (opt == 'f') {
+            shell_input = open(optarg, O_RDONLY | O_CLOEXEC);
+            if (shell_input < 0) {
+                perror(optarg);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [-f SCRIPT]\n", argv[0]);
+            return 1;
+        }
+    }
     init_shell();
 
-    /* Handling signals */
-    setpgid(getpid(), getpid());
-    set_signals(SIG_IGN);
+    /* SIGCHLD stays blocked except while waiting for it; see wait_for_children. */
+    struct sigaction chld_action = {.sa_handler = on_sigchld, .sa_flags = SA_RESTART | SA_NOCLDSTOP};
+    sigset_t chld_set;
+    sigemptyset(&chld_action.sa_mask);
+    sigaction(SIGCHLD, &chld_action, NULL);
+    sigemptyset(&chld_set);
+    sigaddset(&chld_set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_set, &shell_sigmask);
+    sigdelset(&shell_sigmask, SIGCHLD);
+
+    /* Handling signals. Only job control needs them, so scripts skip this. */
+    if (shell_is_interactive) {
+        setpgid(getpid(), getpid());
+        set_signals(SIG_IGN);
+    }
 
-    static char line[4096];
+    shell_reader.fd = shell_input;
+    char* line;
     int line_num = 0;
     int ret_val = 0;
 
     /* Please only print shell prompts when standard input is not a tty */
-    if (shell_is_interactive)
+    if (shell_is_interactive) {
         fprintf(stdout, "%d: ", line_num);
+        fflush(stdout);
+    }
 
-    while (fgets(line, 4096, stdin)) {
+    while ((line = read_line(&shell_reader)) != NULL) {
         /* Split our line into words. */
-        struct tokens* tokens = tokenize(line);
+        bool cached = false;
+        struct tokens* tokens = shell_is_interactive ? tokenize(line) : parse_line(line, &cached);
 
         /* Find which built-in function to run. */
         int fundex = lookup(tokens_get_token(tokens, 0));
 
         if (fundex >= 0) {
             cmd_table[fundex].fun(tokens);
-        } else {
+        } else if (tokens_get_length(tokens) > 0) {
+            size_t input_len = tokens_get_length(tokens);
+            bool background = strcmp(tokens_get_token(tokens, input_len - 1), "&") == 0;
+
+            /* Builtin output must come out before the command's. */
+            fflush(stdout);
             /* Run commands as programs. */
-            process_ID = fork();
-            if (process_ID > 0) {
-                /* Parent process waits. */
-                wait(&status);
-            } else if (process_ID == 0) {
-                /* Child process executes programs. */
-                ret_val = exec_programs(line);
+            if (background && input_len == 1) {
+                fprintf(stderr, "syntax error near '&'\n");
+            } else if (background) {
+                job_t* job = start_job(tokens, input_len - 1, false, -1, -1);
+                if (job != NULL && shell_is_interactive) {
+                    fprintf(stdout, "[%d] %d\n", job->id, job->pgid);
+                }
             } else {
-                perror("Main Fork Failed");
-                return -1;
+                job_t* job = start_job(tokens, input_len, true, -1, -1);
+                if (job != NULL) {
+                    wait_for_job(job);
+                }
             }
         }
+        report_jobs();
 
-        if (shell_is_interactive)
+        if (shell_is_interactive) {
             /* Please only print shell prompts when standard input is not a tty */
             fprintf(stdout, "%d: ", ++line_num);
+            fflush(stdout);
+        }
 
         /* Clean up memory */
-        tokens_destroy(tokens);
+        if (!cached) {
+            tokens_destroy(tokens);
+        }
 
-        set_signals(SIG_IGN);
+        if (shell_is_interactive) {
+            set_signals(SIG_IGN);
+        }
     }
 
+    free(shell_reader.buf);
     return ret_val;
 }
@@ -3,96 +3,73 @@
 #include <string.h>
 #include "tokenizer.h"
 
+/*
+ * A line is tokenized into a single allocation: this struct, then the
+ * NULL-terminated token array, then the text of the tokens. A line of L
+ * bytes has at most L / 2 + 1 tokens, as every token but the last is
+ * followed by a separator, and their text fits in L + 1 bytes, as each
+ * token's NUL can take the place of that separator.
+ */
 struct tokens {
   size_t tokens_length;
   char** tokens;
-  size_t buffers_length;
-  char** buffers;
 };
 
-static void* vector_push(char*** pointer, size_t* size, void* elem) {
-  *pointer = (char**)realloc(*pointer, sizeof(char*) * (*size + 1));
-  (*pointer)[*size] = elem;
-  *size += 1;
-  return elem;
-}
-
-static void* copy_word(char* source, size_t n) {
-  source[n] = '\0';
-  char* word = (char*)malloc(n + 1);
-  strncpy(word, source, n + 1);
-  return word;
-}
-
 struct tokens* tokenize(const char* line) {
   if (line == NULL) {
     return NULL;
   }
 
-  static char token[4096];
-  size_t n = 0, n_max = 4096;
-  struct tokens* tokens;
   size_t line_length = strlen(line);
-
-  tokens = (struct tokens*)malloc(sizeof(struct tokens));
+  size_t max_tokens = line_length / 2 + 1;
+  struct tokens* tokens =
+      (struct tokens*)malloc(sizeof(struct tokens) + sizeof(char*) * (max_tokens + 1) + line_length + 1);
+  if (tokens == NULL) {
+    return NULL;
+  }
   tokens->tokens_length = 0;
-  tokens->tokens = NULL;
-  tokens->buffers_length = 0;
-  tokens->buffers = NULL;
+  tokens->tokens = (char**)(tokens + 1);
+
+  /* The current token runs from TOKEN to OUT, where its next byte goes. */
+  char* token = (char*)(tokens->tokens + max_tokens + 1);
+  char* out = token;
 
   const int MODE_NORMAL = 0, MODE_SQUOTE = 1, MODE_DQUOTE = 2;
   int mode = MODE_NORMAL;
 
-  for (unsigned int i = 0; i < line_length; i++) {
+  for (size_t i = 0; i < line_length; i++) {
     char c = line[i];
-    if (mode == MODE_NORMAL) {
+    if (c == '\\') {
+      /* Escapes work the same inside quotes and out. */
+      if (i + 1 < line_length) {
+        *out++ = line[++i];
+      }
+    } else if (mode == MODE_NORMAL) {
       if (c == '\'') {
         mode = MODE_SQUOTE;
       } else if (c == '"') {
         mode = MODE_DQUOTE;
-      } else if (c == '\\') {
-        if (i + 1 < line_length) {
-          token[n++] = line[++i];
-        }
       } else if (isspace(c)) {
-        if (n > 0) {
-          void* word = copy_word(token, n);
-          vector_push(&tokens->tokens, &tokens->tokens_length, word);
-          n = 0;
+        if (out > token) {
+          *out++ = '\0';
+          tokens->tokens[tokens->tokens_length++] = token;
+          token = out;
         }
       } else {
-        token[n++] = c;
-      }
-    } else if (mode == MODE_SQUOTE) {
-      if (c == '\'') {
-        mode = MODE_NORMAL;
-      } else if (c == '\\') {
-        if (i + 1 < line_length) {
-          token[n++] = line[++i];
-        }
-      } else {
-        token[n++] = c;
-      }
-    } else if (mode == MODE_DQUOTE) {
-      if (c == '"') {
-        mode = MODE_NORMAL;
-      } else if (c == '\\') {
-        if (i + 1 < line_length) {
-          token[n++] = line[++i];
-        }
-      } else {
-        token[n++] = c;
+        *out++ = c;
       }
+    } else if ((mode == MODE_SQUOTE && c == '\'') || (mode == MODE_DQUOTE && c == '"')) {
+      mode = MODE_NORMAL;
+    } else {
+      *out++ = c;
     }
-    if (n + 1 >= n_max)
-      abort();
   }
 
-  if (n > 0) {
-    void* word = copy_word(token, n);
-    vector_push(&tokens->tokens, &tokens->tokens_length, word);
-    n = 0;
+  if (out > token) {
+    *out = '\0';
+    tokens->tokens[tokens->tokens_length++] = token;
   }
+  tokens->tokens[tokens->tokens_length] = NULL;
   return tokens;
 }
 
@@ -112,18 +89,15 @@ char* tokens_get_token(struct tokens* tokens, size_t n) {
   }
 }
 
-void tokens_destroy(struct tokens* tokens) {
+char** tokens_get_argv(struct tokens* tokens) {
   if (tokens == NULL) {
-    return;
-  }
-  for (int i = 0; i < tokens->tokens_length; i++) {
-    free(tokens->tokens[i]);
-  }
-  for (int i = 0; i < tokens->buffers_length; i++) {
-    free(tokens->buffers[i]);
-  }
-  if (tokens->tokens) {
-    free(tokens->tokens);
+    return NULL;
+  } else {
+    return tokens->tokens;
   }
+}
+
+void tokens_destroy(struct tokens* tokens) {
+  /* The array and the words live in the same allocation. */
   free(tokens);
 }
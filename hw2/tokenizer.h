@@ -12,5 +12,8 @@ size_t tokens_get_length(struct tokens* tokens);
 /* Get me the Nth word (zero-indexed) */
 char* tokens_get_token(struct tokens* tokens, size_t n);
 
+/* All the words, NULL-terminated, ready for execv. Owned by TOKENS. */
+char** tokens_get_argv(struct tokens* tokens);
+
 /* Free the memory */
 void tokens_destroy(struct tokens* tokens);
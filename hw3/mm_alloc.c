@@ -9,6 +9,31 @@
 #include <stdio.h>
 #include <string.h>
 
+/* Every block size is a multiple of this, which keeps all data pointers aligned. */
+#define ALIGNMENT 16
+
+/*
+* Free blocks at least this big are also indexed by size so that mm_malloc can
+* do a best fit for them. Smaller free blocks go on one list per size instead.
+* Building with -DMM_FIRST_FIT turns both off and restores plain first fit for
+* every request.
+*/
+#define TREE_MIN_SIZE 128
+
+/* Number of small free lists. List I holds the free blocks of I * ALIGNMENT bytes. */
+#define SMALL_BINS (TREE_MIN_SIZE / ALIGNMENT)
+
+/* Value of heap_t.free for blocks mm_free_batch has released but not merged yet. */
+#define FREE_PENDING 2
+
+/* Number of distinct call sites the heap profiler can track. */
+#define PROFILE_SITES 1024
+
+/*
+* Block header. SIZE is the number of data bytes the block owns, whether it is
+* in use or not. Blocks are kept in address order, but two neighbors in the list
+* are only contiguous in memory if nothing else moved the break in between.
+*/
 typedef struct heap {
     size_t size;
     int free;
@@ -16,7 +41,47 @@ typedef struct heap {
     struct heap* prev;
 } heap_t;
 
+/*
+* Tree links of an indexed free block. They live in the first bytes of its data,
+* which is unused while the block is free.
+*/
+typedef struct free_node {
+    heap_t* left;
+    heap_t* right;
+} free_node_t;
+
+/*
+* List links of a small free block, kept in its data like free_node_t.
+*/
+typedef struct bin_node {
+    heap_t* next;
+    heap_t* prev;
+} bin_node_t;
+
+/* Allocation samples attributed to one call site. */
+typedef struct profile_site {
+    void* caller;
+    size_t samples;
+    size_t bytes;
+} profile_site_t;
+
 heap_t* heap_ptr = NULL;
+heap_t* heap_tail = NULL;
+
+/* Total bytes obtained with sbrk. */
+size_t heap_size = 0;
+
+/* Heap profiler state. PROFILE_RATE is 0 while the profiler is off. */
+unsigned int profile_rate = 0;
+unsigned int profile_countdown = 0;
+size_t profile_dropped = 0;
+profile_site_t profile_sites[PROFILE_SITES];
+
+/* Root of the treap of free blocks keyed by (size, address). */
+heap_t* free_tree = NULL;
+
+/* Heads of the small free lists, most recently freed first. */
+heap_t* small_bins[SMALL_BINS];
 
 /*
 * Returns a pointer to heap_t from a pointer to data.
@@ -33,7 +98,223 @@ void* heap_to_data(heap_t* h_ptr) {
 }
 
 /*
-* Fragments the block if necessary.
+* Rounds a request up to the block size granularity.
+*/
+size_t align_size(size_t size) {
+    return (size + ALIGNMENT - 1) & ~((size_t) ALIGNMENT - 1);
+}
+
+/*
+* Moves the break by INCREMENT bytes, keeping count of the bytes obtained.
+*/
+void* grow_heap(size_t increment) {
+    void* old_break = sbrk(increment);
+
+    if (old_break != (void*) -1) {
+        heap_size += increment;
+    }
+    return old_break;
+}
+
+/*
+* Returns the first address past the data of the block.
+*/
+size_t block_end(heap_t* h_ptr) {
+    return (size_t) heap_to_data(h_ptr) + h_ptr->size;
+}
+
+/*
+* Returns true if the next block starts right where this one ends.
+*/
+int next_is_adjacent(heap_t* h_ptr) {
+    return h_ptr->next != NULL && block_end(h_ptr) == (size_t) h_ptr->next;
+}
+
+#ifndef MM_FIRST_FIT
+
+/*
+* Returns the tree links of a free block.
+*/
+free_node_t* tree_node(heap_t* h_ptr) {
+    return (free_node_t*) heap_to_data(h_ptr);
+}
+
+/*
+* Returns the treap priority of a block, a hash of its address. Blocks are
+* inserted in roughly address order, so the hash has to scramble nearby
+* addresses well or the treap degenerates into a list.
+*/
+unsigned long long tree_priority(heap_t* h_ptr) {
+    unsigned long long key = (size_t) h_ptr;
+
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+/*
+* Returns true if block A sorts before block B, by size and then address.
+*/
+int tree_less(heap_t* a, heap_t* b) {
+    return a->size < b->size || (a->size == b->size && a < b);
+}
+
+/*
+* Joins two treaps where every block in LEFT sorts before every block in RIGHT.
+*/
+heap_t* tree_merge(heap_t* left, heap_t* right) {
+    if (left == NULL) {
+        return right;
+    }
+    if (right == NULL) {
+        return left;
+    }
+
+    if (tree_priority(left) > tree_priority(right)) {
+        tree_node(left)->right = tree_merge(tree_node(left)->right, right);
+        return left;
+    }
+    tree_node(right)->left = tree_merge(left, tree_node(right)->left);
+    return right;
+}
+
+/*
+* Splits ROOT into the blocks sorting before KEY and the rest.
+*/
+void tree_split(heap_t* root, heap_t* key, heap_t** left, heap_t** right) {
+    if (root == NULL) {
+        *left = *right = NULL;
+    } else if (tree_less(root, key)) {
+        tree_split(tree_node(root)->right, key, &tree_node(root)->right, right);
+        *left = root;
+    } else {
+        tree_split(tree_node(root)->left, key, left, &tree_node(root)->left);
+        *right = root;
+    }
+}
+
+/*
+* Inserts ENTRY into the treap rooted at ROOT and returns the new root.
+*/
+heap_t* tree_insert(heap_t* root, heap_t* entry) {
+    if (root == NULL || tree_priority(entry) > tree_priority(root)) {
+        tree_split(root, entry, &tree_node(entry)->left, &tree_node(entry)->right);
+        return entry;
+    }
+
+    if (tree_less(entry, root)) {
+        tree_node(root)->left = tree_insert(tree_node(root)->left, entry);
+    } else {
+        tree_node(root)->right = tree_insert(tree_node(root)->right, entry);
+    }
+    return root;
+}
+
+/*
+* Removes ENTRY from the treap rooted at ROOT and returns the new root.
+*/
+heap_t* tree_remove(heap_t* root, heap_t* entry) {
+    if (root == entry) {
+        return tree_merge(tree_node(root)->left, tree_node(root)->right);
+    }
+
+    if (tree_less(entry, root)) {
+        tree_node(root)->left = tree_remove(tree_node(root)->left, entry);
+    } else {
+        tree_node(root)->right = tree_remove(tree_node(root)->right, entry);
+    }
+    return root;
+}
+
+/*
+* Returns the list links of a small free block.
+*/
+bin_node_t* bin_node(heap_t* h_ptr) {
+    return (bin_node_t*) heap_to_data(h_ptr);
+}
+
+/*
+* Pushes a small free block onto the list for its size.
+*/
+void bin_push(heap_t* h_ptr) {
+    heap_t** bin = &small_bins[h_ptr->size / ALIGNMENT];
+
+    bin_node(h_ptr)->prev = NULL;
+    bin_node(h_ptr)->next = *bin;
+    if (*bin != NULL) {
+        bin_node(*bin)->prev = h_ptr;
+    }
+    *bin = h_ptr;
+}
+
+/*
+* Unlinks a small free block from the list for its size.
+*/
+void bin_remove(heap_t* h_ptr) {
+    bin_node_t* node = bin_node(h_ptr);
+
+    if (node->prev != NULL) {
+        bin_node(node->prev)->next = node->next;
+    } else {
+        small_bins[h_ptr->size / ALIGNMENT] = node->next;
+    }
+    if (node->next != NULL) {
+        bin_node(node->next)->prev = node->prev;
+    }
+}
+
+/*
+* Adds a free block to the size index, or to a small list if it is too small
+* for the index. Blocks too small to hold the list links are left out; they
+* only come back into use by merging with a neighbor.
+*/
+void index_insert(heap_t* h_ptr) {
+    if (h_ptr->size >= TREE_MIN_SIZE) {
+        free_tree = tree_insert(free_tree, h_ptr);
+    } else if (h_ptr->size >= sizeof(bin_node_t)) {
+        bin_push(h_ptr);
+    }
+}
+
+/*
+* Takes a free block out of the size index or its small list. Must run before
+* its size changes.
+*/
+void index_remove(heap_t* h_ptr) {
+    if (h_ptr->size >= TREE_MIN_SIZE) {
+        free_tree = tree_remove(free_tree, h_ptr);
+    } else if (h_ptr->size >= sizeof(bin_node_t)) {
+        bin_remove(h_ptr);
+    }
+}
+
+#else /* MM_FIRST_FIT */
+
+void index_insert(heap_t* h_ptr) { (void) h_ptr; }
+
+void index_remove(heap_t* h_ptr) { (void) h_ptr; }
+
+#endif /* MM_FIRST_FIT */
+
+/* Merges the block following META_PTR into it. The two must be adjacent. */
+void absorb_next(heap_t* meta_ptr) {
+    heap_t* next_neighbor = meta_ptr->next;
+
+    meta_ptr->size += sizeof(heap_t) + next_neighbor->size;
+    meta_ptr->next = next_neighbor->next;
+    if (meta_ptr->next != NULL) {
+        meta_ptr->next->prev = meta_ptr;
+    } else {
+        heap_tail = meta_ptr;
+    }
+}
+
+/*
+* Fragments the block if necessary. The block must not be in the size index;
+* the split-off remainder is added to it.
 */
 void fragment(heap_t* struct_ptr, size_t request_size) {
     size_t original_size;
@@ -43,28 +324,30 @@ void fragment(heap_t* struct_ptr, size_t request_size) {
         return;
     }
 
-    if (struct_ptr->next == NULL) {
-        original_size = (size_t) sbrk(0) - (size_t) struct_ptr - sizeof(heap_t);
-    } else {
-        original_size = (size_t) struct_ptr->next - (size_t) struct_ptr - sizeof(heap_t);
-    }
+    original_size = struct_ptr->size;
 
     if (original_size - request_size > sizeof(heap_t)) {
         new_elem = (heap_t*) ((size_t) struct_ptr + sizeof(heap_t) + request_size);
 
         new_elem->prev = struct_ptr;
         new_elem->free = 1;
+        new_elem->size = original_size - request_size - sizeof(heap_t);
+        new_elem->next = struct_ptr->next;
         
-        if (struct_ptr->next != NULL) {
-            new_elem->next = struct_ptr->next;
-            new_elem->size = (size_t) new_elem->next - (size_t) new_elem - sizeof(heap_t);
-
+        if (new_elem->next != NULL) {
             new_elem->next->prev = new_elem;
         } else {
-          new_elem->next = NULL;
-          new_elem->size = (size_t) sbrk(0) - (size_t)new_elem - sizeof(heap_t);
+            heap_tail = new_elem;
         }
         struct_ptr->next = new_elem;
+        struct_ptr->size = request_size;
+
+        /* Shrinking a block in place can leave the remainder next to a free block. */
+        if (next_is_adjacent(new_elem) && new_elem->next->free) {
+            index_remove(new_elem->next);
+            absorb_next(new_elem);
+        }
+        index_insert(new_elem);
     }
 }
 
@@ -76,6 +359,7 @@ heap_t* find_first_fit(size_t request_size) {
 
     for (iter = heap_ptr; iter != NULL; iter = iter->next) {
         if (iter->free && iter->size >= request_size) {
+            index_remove(iter);
             fragment(iter, request_size);
             return iter;
         }
@@ -83,19 +367,57 @@ heap_t* find_first_fit(size_t request_size) {
     return NULL;
 }
 
+#ifndef MM_FIRST_FIT
+
 /*
-* Returns the last element in the list of structs.
-*/ heap_t* get_last_elem() {
-    heap_t* iter = heap_ptr;
+* Finds the smallest indexed free block that fits, preferring lower addresses
+* among equal sizes, and returns pointer to the struct heap_t.
+*/
+heap_t* find_best_fit(size_t request_size) {
+    heap_t* iter = free_tree;
+    heap_t* best = NULL;
 
     while (iter != NULL) {
-        if (iter->next == NULL) {
-            return iter;
+        if (iter->size >= request_size) {
+            best = iter;
+            iter = tree_node(iter)->left;
+        } else {
+            iter = tree_node(iter)->right;
         }
-        iter = iter->next;
     }
 
-    return NULL;
+    if (best != NULL) {
+        index_remove(best);
+        fragment(best, request_size);
+    }
+    return best;
+}
+
+/*
+* Takes a block for a request smaller than TREE_MIN_SIZE from the first
+* nonempty small list that fits, so the smallest small block that fits, and
+* falls back to the size index. Returns pointer to the struct heap_t.
+*/
+heap_t* find_small_fit(size_t request_size) {
+    heap_t* found;
+
+    for (size_t i = request_size / ALIGNMENT; i < SMALL_BINS; ++i) {
+        found = small_bins[i];
+        if (found != NULL) {
+            index_remove(found);
+            fragment(found, request_size);
+            return found;
+        }
+    }
+    return find_best_fit(request_size);
+}
+
+#endif /* MM_FIRST_FIT */
+
+/*
+* Returns the last element in the list of structs.
+*/ heap_t* get_last_elem() {
+    return heap_tail;
 }
 
 /*
@@ -104,54 +426,149 @@ heap_t* find_first_fit(size_t request_size) {
 void push_back_lst(heap_t* entry) {
     heap_t* last_entry;
 
+    entry->next = NULL;
     if (heap_ptr == NULL) {
         heap_ptr = entry;
         heap_ptr->prev = NULL;
-        heap_ptr->next = NULL;
     } else {
         last_entry = get_last_elem();
 
         entry->prev = last_entry;
         last_entry->next = entry;
     }
+    heap_tail = entry;
 }
 
+/*
+* Records an allocation of SIZE bytes made from CALLER in the profile table.
+*/
+void profile_record(void* caller, size_t size) {
+    size_t slot = ((size_t) caller >> 2) % PROFILE_SITES;
 
-void* mm_malloc(size_t size) {
+    for (size_t probes = 0; probes < PROFILE_SITES; ++probes) {
+        profile_site_t* site = &profile_sites[slot];
+
+        if (site->caller == NULL) {
+            site->caller = caller;
+        }
+        if (site->caller == caller) {
+            site->samples += 1;
+            site->bytes += size;
+            return;
+        }
+        slot = (slot + 1) % PROFILE_SITES;
+    }
+    profile_dropped += 1;
+}
+
+/*
+* Samples one in PROFILE_RATE allocations. Costs a single branch while the
+* profiler is off.
+*/
+void profile_allocation(void* caller, size_t size) {
+    if (profile_rate != 0 && --profile_countdown == 0) {
+        profile_countdown = profile_rate;
+        profile_record(caller, size);
+    }
+}
+
+/*
+* Allocates SIZE zeroed bytes. Shared by mm_malloc and mm_realloc so that the
+* profiler only sees the outermost caller.
+*/
+void* allocate(size_t size) {
   heap_t* found, * meta_ptr;
-  void* data_ptr;
+  size_t misalignment;
 
   if (size == 0) {
       return NULL;
   }
-  
+  size = align_size(size);
+
+#ifdef MM_FIRST_FIT
   found = find_first_fit(size);
+#else
+  found = (size >= TREE_MIN_SIZE) ? find_best_fit(size) : find_small_fit(size);
+#endif
 
   if (found != NULL) {
       found->free = 0;
-      found->size = size;
-      memset(heap_to_data(found), 0, size);
+      memset(heap_to_data(found), 0, found->size);
       return heap_to_data(found);
   } else {
-      meta_ptr = sbrk(sizeof(heap_t));
-      data_ptr = sbrk(size);
+      /* Someone else may have left the break unaligned. */
+      misalignment = (size_t) sbrk(0) % ALIGNMENT;
+      if (misalignment != 0 && grow_heap(ALIGNMENT - misalignment) == (void*) -1) {
+          return NULL;
+      }
 
-      if (meta_ptr == (void*) -1 || data_ptr == (void*) -1) {
+      meta_ptr = grow_heap(sizeof(heap_t) + size);
+
+      if (meta_ptr == (void*) -1) {
           return NULL;
       }
       meta_ptr->free = 0;
       meta_ptr->size = size;
       push_back_lst(meta_ptr);
 
-      memset(data_ptr, 0, size);
-      return data_ptr;
+      memset(heap_to_data(meta_ptr), 0, size);
+      return heap_to_data(meta_ptr);
   }
 }
 
+/*
+* Tries to grow the used block META_PTR to SIZE bytes without moving it, first by
+* absorbing a free successor and then, if the block ends at the break, by moving
+* the break. Returns 1 on success and 0 if the data has to be copied elsewhere.
+*/
+int grow_in_place(heap_t* meta_ptr, size_t size) {
+    size_t old_size = meta_ptr->size;
+    size_t extension;
+    heap_t* next_neighbor = meta_ptr->next;
+
+    if (next_is_adjacent(meta_ptr) && next_neighbor->free &&
+        (next_neighbor->next == NULL || old_size + sizeof(heap_t) + next_neighbor->size >= size)) {
+        index_remove(next_neighbor);
+        absorb_next(meta_ptr);
+    }
+
+    /* Grow the break geometrically so repeated appends don't cost a syscall each. */
+    if (meta_ptr->size < size && meta_ptr->next == NULL && (size_t) sbrk(0) == block_end(meta_ptr)) {
+        extension = size - meta_ptr->size;
+        if (extension < old_size) {
+            extension = old_size;
+        }
+        if (grow_heap(extension) != (void*) -1) {
+            meta_ptr->size += extension;
+        }
+    }
+
+    if (meta_ptr->size < size) {
+        return 0;
+    }
+
+    /* Only the gained bytes the block keeps need clearing; the rest is free again. */
+    fragment(meta_ptr, size);
+    memset((char*) heap_to_data(meta_ptr) + old_size, 0, meta_ptr->size - old_size);
+    return 1;
+}
+
+void* mm_malloc(size_t size) {
+    /* mm_malloc(0) allocates nothing, so it is not sampled either. */
+    if (size > 0) {
+        profile_allocation(__builtin_return_address(0), size);
+    }
+    return allocate(size);
+}
+
 void* mm_realloc(void* ptr, size_t size) {
     void* new_block = NULL;
     size_t cur_size;
 
+    if (size > 0 && (ptr == NULL || align_size(size) > data_to_heap(ptr)->size)) {
+        profile_allocation(__builtin_return_address(0), size);
+    }
+
     if (ptr != NULL) {
         if (size == 0) {
             mm_free(ptr);
@@ -159,8 +576,12 @@ void* mm_realloc(void* ptr, size_t size) {
         } else {
             cur_size = data_to_heap(ptr)->size;
 
-            if (size > cur_size) {
-              new_block = mm_malloc(size);
+            if (align_size(size) > cur_size) {
+              if (grow_in_place(data_to_heap(ptr), align_size(size))) {
+                return ptr;
+              }
+
+              new_block = allocate(size);
               if (new_block == NULL) {
                 return NULL;
               }
@@ -169,42 +590,187 @@ void* mm_realloc(void* ptr, size_t size) {
               mm_free(ptr);
 
               return new_block;
-            } else if (size == cur_size) {
-                return ptr;
             } else {
-                fragment(data_to_heap(ptr), size);
+                /* Keep the bytes past SIZE zeroed in case the block grows back. */
+                memset((char*) ptr + size, 0, cur_size - size);
+                fragment(data_to_heap(ptr), align_size(size));
                 return ptr;
             }
         }
     } else {
-        return mm_malloc(size);
+        return allocate(size);
     }
 }
 
-/* Joins free blocks if necessary. */
+/* Joins free blocks if necessary and indexes the resulting block. */
 void coalesce(heap_t* meta_ptr) {
-    heap_t* prev_neighbor, * next_neighbor;
+    if (next_is_adjacent(meta_ptr) && meta_ptr->next->free) {
+        index_remove(meta_ptr->next);
+        absorb_next(meta_ptr);
+    }
+    if (meta_ptr->prev != NULL && meta_ptr->prev->free && next_is_adjacent(meta_ptr->prev)) {
+        meta_ptr = meta_ptr->prev;
+        index_remove(meta_ptr);
+        absorb_next(meta_ptr);
+    }
+    index_insert(meta_ptr);
+}
+
+/*
+* Allocates SIZE zeroed bytes whose address is a multiple of ALIGN, a power of
+* two. Over-allocates, then gives back the space before the aligned address as
+* a free block and trims the tail.
+*/
+void* aligned_allocate(size_t align, size_t size) {
+    heap_t* meta_ptr, * aligned_ptr;
+    size_t data, aligned_data;
 
-    if (meta_ptr->next != NULL && meta_ptr->next->free) {
-        next_neighbor = meta_ptr->next->next;
-        meta_ptr->next = next_neighbor;
+    if (align <= ALIGNMENT) {
+        return allocate(size);
+    }
+    size = align_size(size);
 
-        if (next_neighbor != NULL) {
-            next_neighbor->prev = meta_ptr;
-            meta_ptr->size = (size_t) next_neighbor - (size_t) heap_to_data(meta_ptr);
-        } else {
-            meta_ptr->size = (size_t) sbrk(0) - (size_t) heap_to_data(meta_ptr);
+    /* Enough for the worst gap below: a header, a minimal free block and an
+     * alignment's worth of padding. */
+    data = (size_t) allocate(size + align + sizeof(heap_t) + ALIGNMENT);
+    if (data == 0) {
+        return NULL;
+    }
+    meta_ptr = data_to_heap((void*) data);
+
+    if (data % align == 0) {
+        fragment(meta_ptr, size);
+        return (void*) data;
+    }
+
+    /* Leave room for a header between the two blocks, and for the free block
+     * in front to hold at least ALIGNMENT bytes. */
+    aligned_data = (data + sizeof(heap_t) + align - 1) & ~(align - 1);
+    if (aligned_data - data < sizeof(heap_t) + ALIGNMENT) {
+        aligned_data += align;
+    }
+    aligned_ptr = data_to_heap((void*) aligned_data);
+
+    aligned_ptr->free = 0;
+    aligned_ptr->size = block_end(meta_ptr) - aligned_data;
+    aligned_ptr->prev = meta_ptr;
+    aligned_ptr->next = meta_ptr->next;
+    if (aligned_ptr->next != NULL) {
+        aligned_ptr->next->prev = aligned_ptr;
+    } else {
+        heap_tail = aligned_ptr;
+    }
+    meta_ptr->next = aligned_ptr;
+    meta_ptr->size = (size_t) aligned_ptr - data;
+    meta_ptr->free = 1;
+
+    coalesce(meta_ptr);
+    fragment(aligned_ptr, size);
+    return (void*) aligned_data;
+}
+
+void* mm_memalign(size_t alignment, size_t size) {
+    if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+
+    profile_allocation(__builtin_return_address(0), size);
+    return aligned_allocate(alignment, size);
+}
+
+size_t mm_malloc_batch(size_t size, size_t alignment, size_t count, void** ptrs) {
+    heap_t* meta_ptr, * next_ptr;
+    size_t stride, end;
+    void* first;
+
+    if (size == 0 || count == 0 || ptrs == NULL || (alignment & (alignment - 1)) != 0) {
+        return 0;
+    }
+    if (alignment < ALIGNMENT) {
+        alignment = ALIGNMENT;
+    }
+
+    /* Spacing between consecutive headers that keeps every object aligned. */
+    stride = (sizeof(heap_t) + align_size(size) + alignment - 1) & ~(alignment - 1);
+    if (stride < size || count > ((size_t) -1 - alignment) / stride) {
+        return 0;
+    }
+
+    profile_allocation(__builtin_return_address(0), size * count);
+    first = aligned_allocate(alignment, count * stride - sizeof(heap_t));
+    if (first == NULL) {
+        return 0;
+    }
+
+    /* Carve the single block into COUNT blocks in one pass. */
+    meta_ptr = data_to_heap(first);
+    end = block_end(meta_ptr);
+    next_ptr = meta_ptr->next;
+    for (size_t i = 0; i < count; ++i) {
+        ptrs[i] = heap_to_data(meta_ptr);
+        meta_ptr->free = 0;
+        if (i + 1 == count) {
+            break;
         }
+        meta_ptr->size = stride - sizeof(heap_t);
+        meta_ptr->next = (heap_t*) ((size_t) meta_ptr + stride);
+        meta_ptr->next->prev = meta_ptr;
+        meta_ptr = meta_ptr->next;
     }
-    if (meta_ptr->prev != NULL && meta_ptr->prev->free) {
-        prev_neighbor = meta_ptr->prev;
-        prev_neighbor->next = meta_ptr->next;
 
-        if (prev_neighbor->next != NULL) {
-            prev_neighbor->next->prev = prev_neighbor;
-            prev_neighbor->size = (size_t) prev_neighbor->next - (size_t) heap_to_data(prev_neighbor);
-        } else {
-            prev_neighbor->size = (size_t) sbrk(0) - (size_t) heap_to_data(prev_neighbor);
+    meta_ptr->size = end - (size_t) heap_to_data(meta_ptr);
+    meta_ptr->next = next_ptr;
+    if (next_ptr != NULL) {
+        next_ptr->prev = meta_ptr;
+    } else {
+        heap_tail = meta_ptr;
+    }
+    fragment(meta_ptr, stride - sizeof(heap_t));
+    return count;
+}
+
+/*
+* Merges the run of adjacent free blocks around META_PTR into one block and
+* indexes it. Blocks absorbed into the run have their free flag cleared so
+* that mm_free_batch skips their stale headers.
+*/
+void merge_free_run(heap_t* meta_ptr) {
+    while (meta_ptr->prev != NULL && meta_ptr->prev->free && next_is_adjacent(meta_ptr->prev)) {
+        meta_ptr = meta_ptr->prev;
+    }
+    if (meta_ptr->free != FREE_PENDING) {
+        index_remove(meta_ptr);
+    }
+    meta_ptr->free = 1;
+
+    while (next_is_adjacent(meta_ptr) && meta_ptr->next->free) {
+        if (meta_ptr->next->free != FREE_PENDING) {
+            index_remove(meta_ptr->next);
+        }
+        meta_ptr->next->free = 0;
+        absorb_next(meta_ptr);
+    }
+    index_insert(meta_ptr);
+}
+
+void mm_free_batch(void** ptrs, size_t count) {
+    heap_t* meta_ptr;
+
+    if (ptrs == NULL) {
+        return;
+    }
+
+    /* Release everything first so each run of neighbors is merged only once. */
+    for (size_t i = 0; i < count; ++i) {
+        if (ptrs[i] != NULL) {
+            meta_ptr = data_to_heap(ptrs[i]);
+            memset(ptrs[i], 0, meta_ptr->size);
+            meta_ptr->free = FREE_PENDING;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (ptrs[i] != NULL && data_to_heap(ptrs[i])->free == FREE_PENDING) {
+            merge_free_run(data_to_heap(ptrs[i]));
         }
     }
 }
@@ -222,3 +788,83 @@ void mm_free(void* ptr) {
 
     coalesce(meta_ptr);
 }
+
+/*
+* Returns the size class of a block with SIZE data bytes.
+*/
+int size_class(size_t size) {
+    int size_cls = 0;
+
+    while (size > 1 && size_cls < MM_SIZE_CLASSES - 1) {
+        size >>= 1;
+        size_cls += 1;
+    }
+    return size_cls;
+}
+
+void mm_stats(mm_stats_t* stats) {
+    heap_t* iter;
+
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(mm_stats_t));
+
+    for (iter = heap_ptr; iter != NULL; iter = iter->next) {
+        if (iter->free) {
+            stats->bytes_free += iter->size;
+            stats->blocks_free += 1;
+            stats->free_per_class[size_class(iter->size)] += 1;
+            if (iter->size > stats->largest_free) {
+                stats->largest_free = iter->size;
+            }
+        } else {
+            stats->bytes_in_use += iter->size;
+            stats->blocks_in_use += 1;
+            stats->used_per_class[size_class(iter->size)] += 1;
+        }
+    }
+
+    stats->heap_size = heap_size;
+    if (stats->bytes_free > 0) {
+        stats->fragmentation = 1.0 - (double) stats->largest_free / stats->bytes_free;
+    }
+}
+
+void mm_profile_start(unsigned int rate) {
+    memset(profile_sites, 0, sizeof(profile_sites));
+    profile_dropped = 0;
+    profile_rate = rate;
+    profile_countdown = rate;
+}
+
+/*
+* Orders profile sites by sampled bytes, largest first.
+*/
+int profile_site_cmp(const void* a, const void* b) {
+    size_t bytes_a = ((const profile_site_t*) a)->bytes;
+    size_t bytes_b = ((const profile_site_t*) b)->bytes;
+
+    return (bytes_a < bytes_b) - (bytes_a > bytes_b);
+}
+
+void mm_profile_dump(FILE* out, size_t top) {
+    /* Sorted copy, so dumping doesn't disturb the hash table. */
+    static profile_site_t sorted[PROFILE_SITES];
+    size_t num_sites = 0;
+
+    for (size_t i = 0; i < PROFILE_SITES; ++i) {
+        if (profile_sites[i].caller != NULL) {
+            sorted[num_sites++] = profile_sites[i];
+        }
+    }
+    qsort(sorted, num_sites, sizeof(profile_site_t), profile_site_cmp);
+
+    fprintf(out, "heap profile: 1 in %u allocations sampled\n", profile_rate);
+    for (size_t i = 0; i < num_sites && i < top; ++i) {
+        fprintf(out, "%p\t%zu samples\t%zu bytes\n", sorted[i].caller, sorted[i].samples, sorted[i].bytes);
+    }
+    if (profile_dropped > 0) {
+        fprintf(out, "%zu samples dropped, too many call sites\n", profile_dropped);
+    }
+}
@@ -9,10 +9,41 @@
 #ifndef _malloc_H_
 #define _malloc_H_
 
+#include <stdio.h>
 #include <stdlib.h>
 
+#include "mm_stats.h"
+
 void* mm_malloc(size_t size);
 void* mm_realloc(void* ptr, size_t size);
 void mm_free(void* ptr);
 
+/* Allocates SIZE bytes at an address that is a multiple of ALIGNMENT, a power of two. */
+void* mm_memalign(size_t alignment, size_t size);
+
+/*
+ * Allocates COUNT objects of SIZE bytes in one call and stores them in PTRS.
+ * Each object is aligned to ALIGNMENT (a power of two, or 0 for the default).
+ * Returns COUNT on success and 0 if nothing was allocated.
+ */
+size_t mm_malloc_batch(size_t size, size_t alignment, size_t count, void** ptrs);
+
+/* Frees the COUNT blocks in PTRS, merging neighbors once per run. NULLs are skipped. */
+void mm_free_batch(void** ptrs, size_t count);
+
+/*
+ * Fills STATS with a snapshot of the heap. Walks every block, so it costs
+ * O(blocks) per call; the allocation paths themselves only count sbrk'd bytes.
+ */
+void mm_stats(mm_stats_t* stats);
+
+/*
+ * Starts recording the caller of one in RATE allocations, or stops recording
+ * if RATE is 0. Starting again clears previous samples.
+ */
+void mm_profile_start(unsigned int rate);
+
+/* Prints the TOP call sites with the most sampled bytes to OUT. */
+void mm_profile_dump(FILE* out, size_t top);
+
 #endif
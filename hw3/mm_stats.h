@@ -0,0 +1,30 @@
+/*
+ * mm_stats.h
+ *
+ * Heap statistics reported by mm_stats(). Kept apart from mm_alloc.h so that
+ * programs loading the allocator with dlopen can use the type too.
+ */
+
+#pragma once
+
+#ifndef _mm_stats_H_
+#define _mm_stats_H_
+
+#include <stddef.h>
+
+/* Size class I holds blocks of [2^I, 2^(I+1)) data bytes. */
+#define MM_SIZE_CLASSES 32
+
+typedef struct mm_stats {
+    size_t bytes_in_use;                    /* data bytes owned by allocated blocks */
+    size_t bytes_free;                      /* data bytes in free blocks */
+    size_t blocks_in_use;
+    size_t blocks_free;
+    size_t used_per_class[MM_SIZE_CLASSES]; /* allocated blocks by size class */
+    size_t free_per_class[MM_SIZE_CLASSES]; /* free blocks by size class */
+    size_t largest_free;                    /* data bytes of the largest free block */
+    size_t heap_size;                       /* total bytes obtained with sbrk */
+    double fragmentation;                   /* 1 - largest_free / bytes_free */
+} mm_stats_t;
+
+#endif
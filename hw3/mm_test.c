@@ -1,12 +1,48 @@
+/*
+ * mm_test.c
+ *
+ * Sanity checks, micro benchmarks and a trace-replay benchmark for hw3lib.so.
+ *
+ *   ./mm_test [-l LIB]                     checks and micro benchmarks
+ *   ./mm_test [-l LIB] [-n OPS] -s NAME    replay a synthetic trace: uniform,
+ *                                          powerlaw, prodcons, realloc or all
+ *   ./mm_test [-l LIB] -t FILE             replay a trace captured with
+ *                                          libmmtrace.so (see mm_trace.c)
+ *
+ * Replays run once against the mm_alloc library and once against libc malloc,
+ * each in a fresh child process, and report ops/sec, peak RSS growth, memory
+ * utilization and per-operation latency percentiles.
+ */
+
 #include <assert.h>
 #include <dlfcn.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm_stats.h"
+
+#define BUILDER_LEN (1 << 16)
+#define MIXED_SLOTS 4096
+#define MIXED_OPS 200000
+#define BATCH_OBJECTS 4096
+#define BATCH_ROUNDS 50
+#define REPLAY_OPS 200000
+#define PAGE_SIZE 4096
 
 /* Function pointers to hw3 functions */
 void* (*mm_malloc)(size_t);
 void* (*mm_realloc)(void*, size_t);
 void (*mm_free)(void*);
+void* (*mm_memalign)(size_t, size_t);
+size_t (*mm_malloc_batch)(size_t, size_t, size_t, void**);
+void (*mm_free_batch)(void**, size_t);
+void (*mm_stats)(mm_stats_t*);
+void (*mm_profile_start)(unsigned int);
+void (*mm_profile_dump)(FILE*, size_t);
 
 static void* try_dlsym(void* handle, const char* symbol) {
   char* error;
@@ -18,8 +54,8 @@ static void* try_dlsym(void* handle, const char* symbol) {
   return function;
 }
 
-static void load_alloc_functions() {
-  void* handle = dlopen("hw3lib.so", RTLD_NOW);
+static void load_alloc_functions(const char* library) {
+  void* handle = dlopen(library, RTLD_NOW);
   if (!handle) {
     fprintf(stderr, "%s\n", dlerror());
     exit(EXIT_FAILURE);
@@ -28,10 +64,603 @@ static void load_alloc_functions() {
   mm_malloc = try_dlsym(handle, "mm_malloc");
   mm_realloc = try_dlsym(handle, "mm_realloc");
   mm_free = try_dlsym(handle, "mm_free");
+  mm_memalign = try_dlsym(handle, "mm_memalign");
+  mm_malloc_batch = try_dlsym(handle, "mm_malloc_batch");
+  mm_free_batch = try_dlsym(handle, "mm_free_batch");
+  mm_stats = try_dlsym(handle, "mm_stats");
+  mm_profile_start = try_dlsym(handle, "mm_profile_start");
+  mm_profile_dump = try_dlsym(handle, "mm_profile_dump");
+}
+
+/* Returns the time elapsed since START in milliseconds. */
+static double elapsed_ms(struct timespec* start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/*
+ * Appends one byte at a time to a buffer grown with mm_realloc, like a string
+ * builder. With GUARD set, a freed block sits between the buffer and a live
+ * allocation, so growth has to absorb the free neighbor instead of moving the
+ * break.
+ */
+static void bench_realloc_growth(int guard) {
+  struct timespec start;
+  char* buf = mm_malloc(1);
+  void* neighbor = NULL;
+  void* fence = NULL;
+
+  if (guard) {
+    neighbor = mm_malloc(BUILDER_LEN);
+    fence = mm_malloc(1);
+    mm_free(neighbor);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t len = 1; len < BUILDER_LEN; ++len) {
+    buf = mm_realloc(buf, len + 1);
+    assert(buf != NULL);
+    buf[len - 1] = 'a' + len % 26;
+  }
+  printf("realloc growth (%s): %d appends in %.2f ms\n", guard ? "free neighbor" : "heap end",
+         BUILDER_LEN - 1, elapsed_ms(&start));
+
+  for (size_t i = 0; i < BUILDER_LEN - 1; ++i) {
+    assert(buf[i] == (char) ('a' + (i + 1) % 26));
+  }
+  mm_free(buf);
+  mm_free(fence);
 }
 
-int main() {
-  load_alloc_functions();
+/* Draws a request size: mostly small, with a tail of medium and large blocks. */
+static size_t mixed_size() {
+  int bucket = rand() % 100;
+  if (bucket < 70) {
+    return 16 + rand() % 240;
+  } else if (bucket < 95) {
+    return 256 + rand() % 3840;
+  }
+  return 4096 + rand() % 61440;
+}
+
+/* Prints the heap statistics and the busiest size classes. */
+static void print_stats() {
+  mm_stats_t stats;
+
+  mm_stats(&stats);
+  printf("heap: %zu KiB sbrk'd, %zu KiB in %zu used blocks, %zu KiB in %zu free blocks\n",
+         stats.heap_size / 1024, stats.bytes_in_use / 1024, stats.blocks_in_use,
+         stats.bytes_free / 1024, stats.blocks_free);
+  printf("largest free block %zu bytes, fragmentation %.2f\n", stats.largest_free,
+         stats.fragmentation);
+  for (int i = 0; i < MM_SIZE_CLASSES; ++i) {
+    if (stats.used_per_class[i] != 0 || stats.free_per_class[i] != 0) {
+      printf("  [%lu, %lu): %zu used, %zu free\n", 1UL << i, 2UL << i, stats.used_per_class[i],
+             stats.free_per_class[i]);
+    }
+  }
+}
+
+/*
+ * Randomly allocates and frees mixed-size blocks over a fixed number of slots
+ * and reports throughput and how far the heap grew.
+ */
+static void bench_mixed_sizes() {
+  static void* slots[MIXED_SLOTS];
+  struct timespec start;
+  size_t heap_start = (size_t) sbrk(0);
+  double ms;
+
+  srand(162);
+  mm_profile_start(64);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < MIXED_OPS; ++i) {
+    int slot = rand() % MIXED_SLOTS;
+    if (slots[slot] != NULL) {
+      mm_free(slots[slot]);
+      slots[slot] = NULL;
+    } else {
+      slots[slot] = mm_malloc(mixed_size());
+      assert(slots[slot] != NULL);
+    }
+  }
+  ms = elapsed_ms(&start);
+  printf("mixed sizes: %d ops in %.2f ms (%.0f ops/s), heap grew %zu KiB\n", MIXED_OPS, ms,
+         MIXED_OPS / (ms / 1e3), ((size_t) sbrk(0) - heap_start) / 1024);
+  print_stats();
+  mm_profile_dump(stdout, 5);
+  mm_profile_start(0);
+
+  for (int i = 0; i < MIXED_SLOTS; ++i) {
+    mm_free(slots[i]);
+  }
+}
+
+/*
+ * Allocates and frees rounds of 64-byte aligned records, once with one
+ * mm_memalign/mm_free call per record and once with the batch calls.
+ */
+static void bench_batch() {
+  static void* records[BATCH_OBJECTS];
+  struct timespec start;
+  double single_ms, batch_ms;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < BATCH_ROUNDS; ++round) {
+    for (int i = 0; i < BATCH_OBJECTS; ++i) {
+      records[i] = mm_memalign(64, 200);
+      assert(records[i] != NULL && (size_t) records[i] % 64 == 0);
+    }
+    for (int i = 0; i < BATCH_OBJECTS; ++i) {
+      mm_free(records[i]);
+    }
+  }
+  single_ms = elapsed_ms(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < BATCH_ROUNDS; ++round) {
+    size_t allocated = mm_malloc_batch(200, 64, BATCH_OBJECTS, records);
+    assert(allocated == BATCH_OBJECTS);
+    for (size_t i = 0; i < allocated; ++i) {
+      assert((size_t) records[i] % 64 == 0);
+    }
+    mm_free_batch(records, allocated);
+  }
+  batch_ms = elapsed_ms(&start);
+
+  printf("%d x %d aligned records: %.2f ms one at a time, %.2f ms batched\n", BATCH_ROUNDS,
+         BATCH_OBJECTS, single_ms, batch_ms);
+}
+
+/* One allocator operation of a trace. SLOT names the block it acts on. */
+typedef struct trace_op {
+  char type; /* 'a'lloc, 'r'ealloc or 'f'ree */
+  unsigned int slot;
+  size_t size;
+} trace_op_t;
+
+typedef struct trace {
+  const char* name;
+  trace_op_t* ops;
+  size_t num_ops;
+  size_t cap_ops;
+  unsigned int num_slots;
+} trace_t;
+
+/* An allocator the traces can be replayed against. */
+typedef struct allocator {
+  const char* name;
+  void* (*malloc)(size_t);
+  void* (*realloc)(void*, size_t);
+  void (*free)(void*);
+} allocator_t;
+
+static void trace_push(trace_t* trace, char type, unsigned int slot, size_t size) {
+  if (trace->num_ops == trace->cap_ops) {
+    trace->cap_ops = trace->cap_ops ? 2 * trace->cap_ops : 1024;
+    trace->ops = realloc(trace->ops, trace->cap_ops * sizeof(trace_op_t));
+    assert(trace->ops != NULL);
+  }
+  trace->ops[trace->num_ops++] = (trace_op_t){type, slot, size};
+  if (slot >= trace->num_slots) {
+    trace->num_slots = slot + 1;
+  }
+}
+
+/* Returns a size in [16, 2^20) whose distribution falls off like 1/size. */
+static size_t power_law_size() {
+  int size_cls = 0;
+  while (size_cls < 15 && rand() % 2 == 0) {
+    ++size_cls;
+  }
+  return (16UL << size_cls) + rand() % (16UL << size_cls);
+}
+
+/*
+ * Builds the synthetic trace NAME with NUM_OPS operations. Returns 0 if there
+ * is no such trace.
+ */
+static int synthetic_trace(trace_t* trace, const char* name, size_t num_ops) {
+  const unsigned int slots = 4096;
+  static size_t sizes[4096];
+  unsigned int head = 0, tail = 0;
+
+  memset(trace, 0, sizeof(trace_t));
+  memset(sizes, 0, sizeof(sizes));
+  trace->name = name;
+  srand(162);
+
+  if (strcmp(name, "uniform") == 0 || strcmp(name, "powerlaw") == 0) {
+    /* Random allocs and frees over a fixed set of slots. */
+    while (trace->num_ops < num_ops) {
+      unsigned int slot = rand() % slots;
+      if (sizes[slot] != 0) {
+        trace_push(trace, 'f', slot, 0);
+        sizes[slot] = 0;
+      } else {
+        sizes[slot] = strcmp(name, "uniform") == 0 ? (size_t) (16 + rand() % 4081) : power_law_size();
+        trace_push(trace, 'a', slot, sizes[slot]);
+      }
+    }
+  } else if (strcmp(name, "prodcons") == 0) {
+    /* A producer queues messages in bursts and a consumer frees them in order. */
+    while (trace->num_ops < num_ops) {
+      int burst = 1 + rand() % 64;
+      for (int i = 0; i < burst && head - tail < slots; ++i, ++head) {
+        trace_push(trace, 'a', head % slots, 64 + rand() % 961);
+      }
+      burst = 1 + rand() % 64;
+      for (int i = 0; i < burst && tail != head; ++i, ++tail) {
+        trace_push(trace, 'f', tail % slots, 0);
+      }
+    }
+  } else if (strcmp(name, "realloc") == 0) {
+    /* Buffers grow by small appends until they are dropped and restarted. */
+    while (trace->num_ops < num_ops) {
+      unsigned int slot = rand() % 64;
+      if (sizes[slot] == 0) {
+        sizes[slot] = 16 + rand() % 64;
+        trace_push(trace, 'a', slot, sizes[slot]);
+      } else if (sizes[slot] > (size_t) 256 * 1024) {
+        trace_push(trace, 'f', slot, 0);
+        sizes[slot] = 0;
+      } else {
+        sizes[slot] += 1 + rand() % 256;
+        trace_push(trace, 'r', slot, sizes[slot]);
+      }
+    }
+  } else {
+    return 0;
+  }
+
+  /* Free whatever is left so both allocators end on an empty heap. */
+  for (; tail != head; ++tail) {
+    trace_push(trace, 'f', tail % slots, 0);
+  }
+  for (unsigned int slot = 0; slot < slots; ++slot) {
+    if (sizes[slot] != 0) {
+      trace_push(trace, 'f', slot, 0);
+    }
+  }
+  return 1;
+}
+
+/* Maps pointers from a captured trace to dense slot numbers. */
+typedef struct slot_map {
+  unsigned long* keys;
+  unsigned int* slots;
+  size_t capacity;
+  size_t used;
+} slot_map_t;
+
+static unsigned int* slot_map_find(slot_map_t* map, unsigned long key) {
+  size_t i = (key >> 4) * 2654435761UL % map->capacity;
+  while (map->keys[i] != 0 && map->keys[i] != key) {
+    i = (i + 1) % map->capacity;
+  }
+  if (map->keys[i] == 0) {
+    map->keys[i] = key;
+    map->slots[i] = (unsigned int) -1;
+    map->used += 1;
+  }
+  return &map->slots[i];
+}
+
+static void slot_map_grow(slot_map_t* map) {
+  slot_map_t bigger = {NULL, NULL, map->capacity ? 2 * map->capacity : 1024, 0};
+
+  bigger.keys = calloc(bigger.capacity, sizeof(unsigned long));
+  bigger.slots = calloc(bigger.capacity, sizeof(unsigned int));
+  assert(bigger.keys != NULL && bigger.slots != NULL);
+  for (size_t i = 0; i < map->capacity; ++i) {
+    if (map->keys[i] != 0 && map->slots[i] != (unsigned int) -1) {
+      *slot_map_find(&bigger, map->keys[i]) = map->slots[i];
+    }
+  }
+  free(map->keys);
+  free(map->slots);
+  *map = bigger;
+}
+
+/*
+ * Loads a trace written by libmmtrace.so. Slots of freed pointers are reused
+ * so that the replay needs no more slots than the program had live blocks.
+ * Returns 0 if the file can't be read.
+ */
+static int load_trace(trace_t* trace, const char* path) {
+  slot_map_t map = {NULL, NULL, 0, 0};
+  unsigned int* free_slots = NULL;
+  size_t num_free = 0, cap_free = 0;
+  unsigned long ptr, new_ptr;
+  size_t size;
+  char line[128];
+  FILE* file = fopen(path, "r");
+
+  if (file == NULL) {
+    return 0;
+  }
+  memset(trace, 0, sizeof(trace_t));
+  trace->name = path;
+  slot_map_grow(&map);
+
+  while (fgets(line, sizeof(line), file)) {
+    unsigned int* slot;
+    if (2 * map.used >= map.capacity) {
+      slot_map_grow(&map);
+    }
+
+    if (sscanf(line, "m %lx %zu", &ptr, &size) == 2) {
+      slot = slot_map_find(&map, ptr);
+      if (*slot != (unsigned int) -1) {
+        /* Reused before we saw it freed: another thread won the race to log. */
+        trace_push(trace, 'f', *slot, 0);
+      } else if (num_free > 0) {
+        *slot = free_slots[--num_free];
+      } else {
+        *slot = trace->num_slots;
+      }
+      trace_push(trace, 'a', *slot, size);
+    } else if (sscanf(line, "r %lx %lx %zu", &ptr, &new_ptr, &size) == 3) {
+      unsigned int old_slot = ptr ? *slot_map_find(&map, ptr) : (unsigned int) -1;
+      if (ptr != 0) {
+        *slot_map_find(&map, ptr) = (unsigned int) -1;
+      }
+      if (new_ptr == 0) {
+        if (old_slot != (unsigned int) -1) {
+          trace_push(trace, 'f', old_slot, 0);
+        }
+        continue;
+      }
+      if (old_slot == (unsigned int) -1) {
+        old_slot = num_free > 0 ? free_slots[--num_free] : trace->num_slots;
+        trace_push(trace, 'a', old_slot, size);
+      } else {
+        trace_push(trace, 'r', old_slot, size);
+      }
+      *slot_map_find(&map, new_ptr) = old_slot;
+    } else if (sscanf(line, "f %lx", &ptr) == 1) {
+      slot = slot_map_find(&map, ptr);
+      if (*slot == (unsigned int) -1) {
+        continue;
+      }
+      trace_push(trace, 'f', *slot, 0);
+      if (num_free == cap_free) {
+        cap_free = cap_free ? 2 * cap_free : 1024;
+        free_slots = realloc(free_slots, cap_free * sizeof(unsigned int));
+        assert(free_slots != NULL);
+      }
+      free_slots[num_free++] = *slot;
+      *slot = (unsigned int) -1;
+    }
+  }
+  fclose(file);
+
+  free(map.keys);
+  free(map.slots);
+  free(free_slots);
+  return 1;
+}
+
+static long long now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int compare_ll(const void* a, const void* b) {
+  long long x = *(const long long*) a, y = *(const long long*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Reads a "<FIELD>: <n> kB" line from /proc/self/status. Returns 0 if the
+ * field is missing.
+ */
+static long proc_status_kib(const char* field) {
+  char line[128];
+  long kib = 0;
+  size_t len = strlen(field);
+  FILE* status = fopen("/proc/self/status", "r");
+
+  if (status == NULL) {
+    return 0;
+  }
+  while (fgets(line, sizeof(line), status)) {
+    if (strncmp(line, field, len) == 0 && line[len] == ':') {
+      kib = strtol(line + len + 1, NULL, 10);
+      break;
+    }
+  }
+  fclose(status);
+  return kib;
+}
+
+/* Resets the peak RSS of this process to its current RSS. */
+static void reset_peak_rss() {
+  FILE* clear_refs = fopen("/proc/self/clear_refs", "w");
+
+  if (clear_refs != NULL) {
+    fputs("5", clear_refs);
+    fclose(clear_refs);
+  }
+}
+
+/*
+ * Replays TRACE against ALLOC and prints one line of results. Meant to run in
+ * a fresh child so that peak RSS belongs to this allocator alone. All
+ * bookkeeping memory is allocated and touched before the clock starts.
+ */
+static void replay(trace_t* trace, allocator_t* alloc) {
+  char** blocks = calloc(trace->num_slots, sizeof(char*));
+  size_t* sizes = calloc(trace->num_slots, sizeof(size_t));
+  long long* latency = malloc(trace->num_ops * sizeof(long long));
+  size_t live = 0, peak_live = 0, failures = 0;
+  long long total_ns = 0;
+  long start_rss, peak_rss;
+
+  assert(blocks != NULL && sizes != NULL && latency != NULL);
+  /* calloc can hand back untouched zero pages, so write them all. */
+  memset(blocks, 0, trace->num_slots * sizeof(char*));
+  memset(sizes, 0, trace->num_slots * sizeof(size_t));
+  memset(latency, 0, trace->num_ops * sizeof(long long));
+  reset_peak_rss();
+  start_rss = proc_status_kib("VmRSS");
+
+  for (size_t i = 0; i < trace->num_ops; ++i) {
+    trace_op_t* op = &trace->ops[i];
+    long long begin = now_ns();
+
+    if (op->type == 'a') {
+      blocks[op->slot] = alloc->malloc(op->size);
+    } else if (op->type == 'r') {
+      blocks[op->slot] = alloc->realloc(blocks[op->slot], op->size);
+    } else {
+      alloc->free(blocks[op->slot]);
+      blocks[op->slot] = NULL;
+    }
+    latency[i] = now_ns() - begin;
+    total_ns += latency[i];
+
+    /* Touch every page like a real program would, outside the timed region. */
+    live -= sizes[op->slot];
+    sizes[op->slot] = 0;
+    if (op->type != 'f') {
+      if (blocks[op->slot] == NULL) {
+        ++failures;
+        continue;
+      }
+      for (size_t offset = 0; offset < op->size; offset += PAGE_SIZE) {
+        blocks[op->slot][offset] = 1;
+      }
+      sizes[op->slot] = op->size;
+      live += op->size;
+      if (live > peak_live) {
+        peak_live = live;
+      }
+    }
+  }
+
+  peak_rss = proc_status_kib("VmHWM") - start_rss;
+  if (peak_rss < 1) {
+    peak_rss = 1;
+  }
+  qsort(latency, trace->num_ops, sizeof(long long), compare_ll);
+
+#define PERCENTILE(p) latency[(size_t) ((trace->num_ops - 1) * (p))]
+  printf("%-12s %-7s %10.0f %10ld %6.2f %7lld %7lld %8lld %9lld %s\n", trace->name, alloc->name,
+         trace->num_ops / (total_ns / 1e9), peak_rss, peak_live / 1024.0 / peak_rss,
+         PERCENTILE(0.5), PERCENTILE(0.99), PERCENTILE(0.999), latency[trace->num_ops - 1],
+         failures ? "(allocation failures)" : "");
+#undef PERCENTILE
+}
+
+/*
+ * Replays TRACE against mm_alloc and libc malloc, each in its own child, and
+ * reports any child that does not exit cleanly. Traces with no operations are
+ * skipped, since there is nothing to time.
+ */
+static void compare_allocators(trace_t* trace) {
+  allocator_t allocators[] = {
+      {"mm", NULL, NULL, NULL},
+      {"libc", malloc, realloc, free},
+  };
+  allocators[0].malloc = mm_malloc;
+  allocators[0].realloc = mm_realloc;
+  allocators[0].free = mm_free;
+
+  if (trace->num_ops == 0) {
+    fprintf(stderr, "%s: no operations to replay\n", trace->name);
+    return;
+  }
+  for (size_t i = 0; i < sizeof(allocators) / sizeof(allocator_t); ++i) {
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+      replay(trace, &allocators[i]);
+      fflush(stdout);
+      _exit(0);
+    } else if (pid > 0) {
+      if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+      } else if (WIFSIGNALED(status)) {
+        fprintf(stderr, "%s %s: replay killed by signal %d\n", trace->name,
+                allocators[i].name, WTERMSIG(status));
+      } else if (WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s %s: replay exited with status %d\n", trace->name,
+                allocators[i].name, WEXITSTATUS(status));
+      }
+    } else {
+      perror("fork");
+    }
+  }
+}
+
+static void print_replay_header() {
+  printf("%-12s %-7s %10s %10s %6s %7s %7s %8s %9s\n", "trace", "alloc", "ops/s", "rss KiB",
+         "util", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+}
+
+int main(int argc, char* argv[]) {
+  const char* synthetic[] = {"uniform", "powerlaw", "prodcons", "realloc"};
+  const char* library = "hw3lib.so";
+  size_t num_ops = REPLAY_OPS;
+  int replayed = 0;
+  trace_t trace;
+  int opt;
+
+  /* Parse the library first, since replays need it loaded. */
+  while ((opt = getopt(argc, argv, "l:n:s:t:")) != -1) {
+    if (opt == 'l') {
+      library = optarg;
+    } else if (opt == 'n') {
+      num_ops = strtoul(optarg, NULL, 10);
+    } else if (opt == '?') {
+      fprintf(stderr, "usage: %s [-l LIB] [-n OPS] [-s NAME|all] [-t TRACE]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  load_alloc_functions(library);
+
+  optind = 1;
+  while ((opt = getopt(argc, argv, "l:n:s:t:")) != -1) {
+    if (opt != 's' && opt != 't') {
+      continue;
+    }
+    if (!replayed++) {
+      print_replay_header();
+    }
+
+    if (opt == 't') {
+      if (!load_trace(&trace, optarg)) {
+        perror(optarg);
+        return EXIT_FAILURE;
+      }
+      compare_allocators(&trace);
+      free(trace.ops);
+      continue;
+    }
+    if (strcmp(optarg, "all") != 0) {
+      if (!synthetic_trace(&trace, optarg, num_ops)) {
+        fprintf(stderr, "%s: no synthetic trace named %s\n", argv[0], optarg);
+        return EXIT_FAILURE;
+      }
+      compare_allocators(&trace);
+      free(trace.ops);
+      continue;
+    }
+    for (size_t i = 0; i < sizeof(synthetic) / sizeof(char*); ++i) {
+      synthetic_trace(&trace, synthetic[i], num_ops);
+      compare_allocators(&trace);
+      free(trace.ops);
+    }
+  }
+  if (replayed) {
+    return 0;
+  }
 
 //   int* data = mm_malloc(sizeof(int));
 //   assert(data != NULL);
@@ -46,6 +675,11 @@ int main() {
   int* sec_ptr = mm_malloc(5);
   size_t copy2 = (size_t)sec_ptr;
     mm_free(sec_ptr);
-  printf("%lu, %lu", copy1, copy2);
+  printf("%lu, %lu\n", copy1, copy2);
 
+  bench_realloc_growth(0);
+  bench_realloc_growth(1);
+  bench_mixed_sizes();
+  bench_batch();
+  return 0;
 }
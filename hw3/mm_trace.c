@@ -0,0 +1,95 @@
+/*
+ * mm_trace.c
+ *
+ * LD_PRELOAD shim that records every malloc, calloc, realloc and free a
+ * program makes, so mm_test can replay the program's allocation pattern:
+ *
+ *   MM_TRACE=ls.trace LD_PRELOAD=./libmmtrace.so ls -R /usr > /dev/null
+ *   ./mm_test -t ls.trace
+ *
+ * One operation per line, with pointers in hex:
+ *   m <ptr> <size>          malloc or calloc
+ *   r <old> <new> <size>    realloc
+ *   f <ptr>                 free
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* glibc's own entry points, so the shim never has to look up the real malloc. */
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+static int trace_fd = -1;
+
+/* Set while a thread is inside the shim, so allocations made by the C library
+ * on our behalf are not recorded. */
+static __thread int in_shim;
+
+__attribute__((constructor)) static void trace_open(void) {
+  const char* path = getenv("MM_TRACE");
+
+  if (path != NULL) {
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  }
+}
+
+/* Appends one formatted line to the trace with a single write, which keeps
+ * lines from different threads whole. */
+static void trace_line(const char* line, int len) {
+  if (len > 0 && write(trace_fd, line, len) < 0) {
+    trace_fd = -1;
+  }
+}
+
+static void trace_alloc(void* ptr, size_t size) {
+  char line[64];
+
+  if (trace_fd < 0 || in_shim || ptr == NULL) {
+    return;
+  }
+  in_shim = 1;
+  trace_line(line, snprintf(line, sizeof(line), "m %lx %zu\n", (unsigned long) ptr, size));
+  in_shim = 0;
+}
+
+void* malloc(size_t size) {
+  void* ptr = __libc_malloc(size);
+  trace_alloc(ptr, size);
+  return ptr;
+}
+
+void* calloc(size_t nmemb, size_t size) {
+  void* ptr = __libc_calloc(nmemb, size);
+  trace_alloc(ptr, nmemb * size);
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+  char line[96];
+  void* new_ptr = __libc_realloc(ptr, size);
+
+  if (trace_fd >= 0 && !in_shim && (new_ptr != NULL || size == 0)) {
+    in_shim = 1;
+    trace_line(line, snprintf(line, sizeof(line), "r %lx %lx %zu\n", (unsigned long) ptr,
+                              (unsigned long) new_ptr, size));
+    in_shim = 0;
+  }
+  return new_ptr;
+}
+
+void free(void* ptr) {
+  char line[32];
+
+  if (trace_fd >= 0 && !in_shim && ptr != NULL) {
+    in_shim = 1;
+    trace_line(line, snprintf(line, sizeof(line), "f %lx\n", (unsigned long) ptr));
+    in_shim = 0;
+  }
+  __libc_free(ptr);
+}
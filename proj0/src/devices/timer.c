@@ -20,11 +20,17 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Threads blocked in timer_sleep(), in order of wakeup_tick.
+   Threads with the same wakeup_tick are kept in the order they
+   went to sleep. */
+static struct list sleep_list;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static bool wakes_earlier(const struct list_elem*, const struct list_elem*, void* aux);
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
@@ -33,6 +39,7 @@ static void real_time_delay(int64_t num, int32_t denom);
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void timer_init(void) {
+  list_init(&sleep_list);
   pit_configure_channel(0, 2, TIMER_FREQ);
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
@@ -74,13 +81,25 @@ int64_t timer_ticks(void) {
 int64_t timer_elapsed(int64_t then) { return timer_ticks() - then; }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The thread blocks on the sleep list until timer_interrupt()
+   wakes it, instead of taking CPU time away from threads that
+   can run. */
 void timer_sleep(int64_t ticks) {
   int64_t start = timer_ticks();
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
 
   ASSERT(intr_get_level() == INTR_ON);
-  while (timer_elapsed(start) < ticks)
-    thread_yield();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable();
+  cur->wakeup_tick = start + ticks;
+  list_insert_ordered(&sleep_list, &cur->elem, wakes_earlier, NULL);
+  thread_block();
+  intr_set_level(old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -125,12 +144,31 @@ void timer_ndelay(int64_t ns) { real_time_delay(ns, 1000 * 1000 * 1000); }
 /* Prints timer statistics. */
 void timer_print_stats(void) { printf("Timer: %" PRId64 " ticks\n", timer_ticks()); }
 
-/* Timer interrupt handler. */
+/* Timer interrupt handler.  Wakes every sleeping thread whose
+   time has come, which are all at the front of the sleep list,
+   so this only looks at the threads it wakes plus one. */
 static void timer_interrupt(struct intr_frame* args UNUSED) {
   ticks++;
+
+  while (!list_empty(&sleep_list)) {
+    struct thread* t = list_entry(list_front(&sleep_list), struct thread, elem);
+    if (t->wakeup_tick > ticks)
+      break;
+    list_pop_front(&sleep_list);
+    thread_unblock(t);
+  }
+
   thread_tick();
 }
 
+/* Returns true if the thread owning A wakes before the one
+   owning B. */
+static bool wakes_earlier(const struct list_elem* a, const struct list_elem* b,
+                          void* aux UNUSED) {
+  return list_entry(a, struct thread, elem)->wakeup_tick <
+         list_entry(b, struct thread, elem)->wakeup_tick;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool too_many_loops(unsigned loops) {
@@ -63,6 +63,7 @@ static void paging_init(void);
 static char** read_command_line(void);
 static char** parse_options(char** argv);
 static void run_actions(char** argv);
+static void print_stats(char** argv);
 static void usage(void);
 
 #ifdef FILESYS
@@ -275,6 +276,9 @@ static void run_task(char** argv) {
   printf("Execution of '%s' complete.\n", task);
 }
 
+/* Prints scheduler statistics so far. */
+static void print_stats(char** argv UNUSED) { thread_print_stats(); }
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void run_actions(char** argv) {
@@ -288,6 +292,7 @@ static void run_actions(char** argv) {
   /* Table of supported actions. */
   static const struct action actions[] = {
       {"run", 2, run_task},
+      {"stats", 1, print_stats},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -332,6 +337,7 @@ static void usage(void) {
 #else
          "  run TEST           Run TEST.\n"
 #endif
+         "  stats              Print scheduler statistics so far.\n"
 #ifdef FILESYS
          "  ls                 List files in the root directory.\n"
          "  cat FILE           Print FILE to the console.\n"
@@ -32,6 +32,14 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* How many locks down a chain of holders lock_acquire() donates
+   priority.  Bounds the work done when a thread blocks. */
+#define DONATION_DEPTH 8
+
+static bool lower_priority(const struct list_elem*, const struct list_elem*, void* aux);
+static bool lower_priority_waiter(const struct list_elem*, const struct list_elem*, void* aux);
+static void donate_priority(struct lock*, int priority);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -93,7 +101,10 @@ bool sema_try_down(struct semaphore* sema) {
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any, or the first of them to wait if there is a tie.
+   Yields if the woken thread has a higher priority than the
+   running one.
 
    This function may be called from an interrupt handler. */
 void sema_up(struct semaphore* sema) {
@@ -102,9 +113,15 @@ void sema_up(struct semaphore* sema) {
   ASSERT(sema != NULL);
 
   old_level = intr_disable();
-  if (!list_empty(&sema->waiters))
-    thread_unblock(list_entry(list_pop_front(&sema->waiters), struct thread, elem));
+  if (!list_empty(&sema->waiters)) {
+    /* Waiters' priorities change with donation, so the list is
+       not kept sorted. */
+    struct list_elem* e = list_max(&sema->waiters, lower_priority, NULL);
+    list_remove(e);
+    thread_unblock(list_entry(e, struct thread, elem));
+  }
   sema->value++;
+  thread_preempt();
   intr_set_level(old_level);
 }
 
@@ -163,19 +180,50 @@ void lock_init(struct lock* lock) {
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
-   thread.
+   thread.  While it waits, the current thread donates its
+   priority to the holder, and on through the locks that the
+   holder is waiting for, unless the MLFQS is in use.
 
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
    we need to sleep. */
 void lock_acquire(struct lock* lock) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
   ASSERT(lock != NULL);
   ASSERT(!intr_context());
   ASSERT(!lock_held_by_current_thread(lock));
 
+  old_level = intr_disable();
+  if (lock->holder != NULL && !thread_mlfqs) {
+    cur->waiting_lock = lock;
+    donate_priority(lock, cur->priority);
+  }
   sema_down(&lock->semaphore);
-  lock->holder = thread_current();
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back(&cur->held_locks, &lock->elem);
+  intr_set_level(old_level);
+}
+
+/* Raises the priority of LOCK's holder to PRIORITY, then that of
+   the holder of the lock it is waiting for, and so on for up to
+   DONATION_DEPTH locks.  Stops early at a holder that already
+   runs at PRIORITY or higher, since everything past it does
+   too.  Interrupts must be off. */
+static void donate_priority(struct lock* lock, int priority) {
+  int depth;
+
+  for (depth = 0; depth < DONATION_DEPTH && lock != NULL && lock->holder != NULL; depth++) {
+    struct thread* holder = lock->holder;
+
+    if (holder->priority >= priority)
+      break;
+    thread_donate_priority(holder, priority);
+    lock = holder->waiting_lock;
+  }
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -185,28 +233,42 @@ void lock_acquire(struct lock* lock) {
    This function will not sleep, so it may be called within an
    interrupt handler. */
 bool lock_try_acquire(struct lock* lock) {
+  enum intr_level old_level;
   bool success;
 
   ASSERT(lock != NULL);
   ASSERT(!lock_held_by_current_thread(lock));
 
+  old_level = intr_disable();
   success = sema_try_down(&lock->semaphore);
-  if (success)
+  if (success) {
     lock->holder = thread_current();
+    list_push_back(&lock->holder->held_locks, &lock->elem);
+  }
+  intr_set_level(old_level);
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
+   The current thread gives up any priority donated to it
+   through LOCK, and yields if that leaves a ready thread with a
+   higher priority.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
    handler. */
 void lock_release(struct lock* lock) {
+  enum intr_level old_level;
+
   ASSERT(lock != NULL);
   ASSERT(lock_held_by_current_thread(lock));
 
+  old_level = intr_disable();
   lock->holder = NULL;
+  list_remove(&lock->elem);
+  thread_refresh_priority();
   sema_up(&lock->semaphore);
+  intr_set_level(old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -222,6 +284,7 @@ bool lock_held_by_current_thread(const struct lock* lock) {
 struct semaphore_elem {
   struct list_elem elem;      /* List element. */
   struct semaphore semaphore; /* This semaphore. */
+  struct thread* thread;      /* Thread waiting on SEMAPHORE. */
 };
 
 /* Initializes condition variable COND.  A condition variable
@@ -262,6 +325,7 @@ void cond_wait(struct condition* cond, struct lock* lock) {
   ASSERT(lock_held_by_current_thread(lock));
 
   sema_init(&waiter.semaphore, 0);
+  waiter.thread = thread_current();
   list_push_back(&cond->waiters, &waiter.elem);
   lock_release(lock);
   sema_down(&waiter.semaphore);
@@ -269,8 +333,9 @@ void cond_wait(struct condition* cond, struct lock* lock) {
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the highest-priority one of them to wake
+   up from its wait.  LOCK must be held before calling this
+   function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -281,8 +346,11 @@ void cond_signal(struct condition* cond, struct lock* lock UNUSED) {
   ASSERT(!intr_context());
   ASSERT(lock_held_by_current_thread(lock));
 
-  if (!list_empty(&cond->waiters))
-    sema_up(&list_entry(list_pop_front(&cond->waiters), struct semaphore_elem, elem)->semaphore);
+  if (!list_empty(&cond->waiters)) {
+    struct list_elem* e = list_max(&cond->waiters, lower_priority_waiter, NULL);
+    list_remove(e);
+    sema_up(&list_entry(e, struct semaphore_elem, elem)->semaphore);
+  }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -298,3 +366,19 @@ void cond_broadcast(struct condition* cond, struct lock* lock) {
   while (!list_empty(&cond->waiters))
     cond_signal(cond, lock);
 }
+
+/* Returns true if the thread owning A has a lower priority than
+   the one owning B. */
+static bool lower_priority(const struct list_elem* a, const struct list_elem* b,
+                           void* aux UNUSED) {
+  return list_entry(a, struct thread, elem)->priority <
+         list_entry(b, struct thread, elem)->priority;
+}
+
+/* Returns true if the thread waiting on condition variable
+   waiter A has a lower priority than the one waiting on B. */
+static bool lower_priority_waiter(const struct list_elem* a, const struct list_elem* b,
+                                  void* aux UNUSED) {
+  return list_entry(a, struct semaphore_elem, elem)->thread->priority <
+         list_entry(b, struct semaphore_elem, elem)->thread->priority;
+}
@@ -4,6 +4,7 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
@@ -20,9 +21,18 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, in one FIFO queue per
+   priority.  Bit P of ready_mask is set if and only if
+   ready_queues[P] is not empty, so finding the highest priority
+   with a ready thread takes a bit scan instead of a walk over
+   the threads. */
+#if PRI_MIN != 0 || PRI_MAX > 63
+#error ready_mask needs priorities to fit in 0...63
+#endif
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static int ready_count; /* # of threads in the run queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -45,9 +55,43 @@ struct kernel_thread_frame {
 };
 
 /* Statistics. */
-static long long idle_ticks;   /* # of timer ticks spent idle. */
-static long long kernel_ticks; /* # of timer ticks in kernel threads. */
-static long long user_ticks;   /* # of timer ticks in user programs. */
+static long long idle_ticks;     /* # of timer ticks spent idle. */
+static long long kernel_ticks;   /* # of timer ticks in kernel threads. */
+static long long user_ticks;     /* # of timer ticks in user programs. */
+static long long vol_switches;   /* # of switches away from a blocked thread. */
+static long long invol_switches; /* # of switches away from a ready thread. */
+
+/* Histogram of how long threads wait in the run queues, from
+   thread_unblock() or thread_yield() to being picked to run, in
+   timer ticks.  Bucket 0 counts waits of 0 ticks, and bucket B
+   waits of 2**(B-1) to 2**B - 1 ticks, except that the last
+   bucket also takes everything longer. */
+#define WAIT_BUCKETS 16
+static long long wait_hist[WAIT_BUCKETS];
+
+/* One thread's line of thread_print_stats(). */
+struct thread_stats {
+  tid_t tid;
+  char name[16];
+  int priority;
+  unsigned run_ticks;
+  unsigned vol_switches;
+  unsigned invol_switches;
+  int64_t wait_ticks;
+  int64_t max_wait;
+};
+
+/* Copies of thread_stats, STATS_THREADS at most.  The copies
+   are static because thread_print_stats() also runs on the way
+   down from a kernel panic, with interrupts off and maybe in an
+   interrupt handler, where it must not allocate or take locks. */
+#define STATS_THREADS 64
+struct stats_snapshot {
+  struct thread_stats threads[STATS_THREADS]; /* The copies. */
+  size_t cnt;                                 /* # of threads copied. */
+  size_t total;                               /* # of threads seen. */
+};
+static struct stats_snapshot stats_snapshot;
 
 /* Scheduling. */
 #define TIME_SLICE 4          /* # of timer ticks to give each thread. */
@@ -58,11 +102,27 @@ static unsigned thread_ticks; /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler. */
+#define NICE_MIN -20           /* Lowest nice value. */
+#define NICE_MAX 20            /* Highest nice value. */
+#define PRIORITY_INTERVAL 4    /* # of timer ticks between priority updates. */
+static fixed_point_t load_avg; /* # of threads ready, averaged over the last minute. */
+
 static void kernel_thread(thread_func*, void* aux);
 
 static void idle(void* aux UNUSED);
 static struct thread* running_thread(void);
 static struct thread* next_thread_to_run(void);
+static void ready_push(struct thread*);
+static void ready_remove(struct thread*);
+static int ready_max_priority(void);
+static int running_priority(void);
+static int mlfqs_priority(const struct thread*);
+static void mlfqs_update_priority(struct thread*, void* aux);
+static void mlfqs_decay_recent_cpu(struct thread*, void* aux);
+static void mlfqs_tick(struct thread*);
+static void record_wait(struct thread*);
+static void snapshot_thread_stats(struct thread*, void* aux);
 static void init_thread(struct thread*, const char* name, int priority);
 static bool is_thread(struct thread*) UNUSED;
 static void* alloc_frame(struct thread*, size_t size);
@@ -87,7 +147,8 @@ void thread_init(void) {
   ASSERT(intr_get_level() == INTR_OFF);
 
   lock_init(&tid_lock);
-  list_init(&ready_list);
+  for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    list_init(&ready_queues[pri]);
   list_init(&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -118,6 +179,7 @@ void thread_tick(void) {
   struct thread* t = thread_current();
 
   /* Update statistics. */
+  t->run_ticks++;
   if (t == idle_thread)
     idle_ticks++;
 #ifdef USERPROG
@@ -127,15 +189,102 @@ void thread_tick(void) {
   else
     kernel_ticks++;
 
+  if (thread_mlfqs)
+    mlfqs_tick(t);
+
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return();
 }
 
-/* Prints thread statistics. */
+/* Does the MLFQS bookkeeping for a timer tick, with T as the
+   running thread.  Only T's recent_cpu changes from one tick to
+   the next, so T is the only thread whose priority has to be
+   recomputed every PRIORITY_INTERVAL ticks.  Once a second, every
+   thread's recent_cpu decays, and every thread's priority is
+   recomputed. */
+static void mlfqs_tick(struct thread* t) {
+  int64_t now = timer_ticks();
+
+  if (t != idle_thread)
+    t->recent_cpu = fix_add(t->recent_cpu, fix_int(1));
+
+  if (now % TIMER_FREQ == 0) {
+    int ready = ready_count + (t != idle_thread);
+    fixed_point_t decay;
+
+    load_avg = fix_add(fix_mul(fix_frac(59, 60), load_avg), fix_frac(ready, 60));
+    decay = fix_div(fix_scale(load_avg, 2), fix_add(fix_scale(load_avg, 2), fix_int(1)));
+    thread_foreach(mlfqs_decay_recent_cpu, &decay);
+    thread_foreach(mlfqs_update_priority, NULL);
+  } else if (now % PRIORITY_INTERVAL == 0)
+    mlfqs_update_priority(t, NULL);
+
+  if (ready_max_priority() > running_priority())
+    intr_yield_on_return();
+}
+
+/* Prints thread statistics: overall, the histogram of run
+   queue waits, and then for each thread that has not exited. */
 void thread_print_stats(void) {
+  struct stats_snapshot* snap = &stats_snapshot;
+  enum intr_level old_level;
+  size_t i;
+  int b;
+
   printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n", idle_ticks, kernel_ticks,
          user_ticks);
+  printf("Thread: %lld voluntary, %lld involuntary context switches\n", vol_switches,
+         invol_switches);
+  printf("Thread: ready waits in ticks:");
+  for (b = 0; b < WAIT_BUCKETS; b++) {
+    if (wait_hist[b] == 0)
+      continue;
+    if (b <= 1)
+      printf(" %d:%lld", b, wait_hist[b]);
+    else if (b < WAIT_BUCKETS - 1)
+      printf(" %d-%d:%lld", 1 << (b - 1), (1 << b) - 1, wait_hist[b]);
+    else
+      printf(" %d+:%lld", 1 << (b - 1), wait_hist[b]);
+  }
+  printf("\n");
+
+  /* printf() may sleep on the console lock, and threads may exit
+     while it does, so the per-thread numbers are copied out with
+     interrupts off and printed afterward. */
+  old_level = intr_disable();
+  snap->cnt = snap->total = 0;
+  thread_foreach(snapshot_thread_stats, snap);
+  intr_set_level(old_level);
+
+  for (i = 0; i < snap->cnt; i++) {
+    struct thread_stats* t = &snap->threads[i];
+    printf("  %3d %-16s pri %2d: %u ticks run, %u vol, %u invol switches, "
+           "%lld ticks ready (max %lld)\n",
+           t->tid, t->name, t->priority, t->run_ticks, t->vol_switches, t->invol_switches,
+           t->wait_ticks, t->max_wait);
+  }
+  if (snap->total > snap->cnt)
+    printf("  ... and %zu more threads\n", snap->total - snap->cnt);
+}
+
+/* Copies T's statistics into the stats_snapshot AUX, if there
+   is room left, and counts T either way. */
+static void snapshot_thread_stats(struct thread* t, void* snap_) {
+  struct stats_snapshot* snap = snap_;
+
+  snap->total++;
+  if (snap->cnt < STATS_THREADS) {
+    struct thread_stats* s = &snap->threads[snap->cnt++];
+    s->tid = t->tid;
+    strlcpy(s->name, t->name, sizeof s->name);
+    s->priority = t->priority;
+    s->run_ticks = t->run_ticks;
+    s->vol_switches = t->vol_switches;
+    s->invol_switches = t->invol_switches;
+    s->wait_ticks = t->wait_ticks;
+    s->max_wait = t->max_wait;
+  }
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -150,9 +299,8 @@ void thread_print_stats(void) {
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running one,
+   it runs before thread_create() returns. */
 tid_t thread_create(const char* name, int priority, thread_func* function, void* aux) {
   struct thread* t;
   struct kernel_thread_frame* kf;
@@ -188,6 +336,7 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
 
   /* Add to run queue. */
   thread_unblock(t);
+  thread_preempt();
 
   return tid;
 }
@@ -213,7 +362,10 @@ void thread_block(void) {
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  Callers outside interrupt handlers should
+   call thread_preempt() once that is done.  Within an interrupt
+   handler, the running thread yields on return from it if T has
+   a higher priority. */
 void thread_unblock(struct thread* t) {
   enum intr_level old_level;
 
@@ -221,8 +373,26 @@ void thread_unblock(struct thread* t) {
 
   old_level = intr_disable();
   ASSERT(t->status == THREAD_BLOCKED);
-  list_push_back(&ready_list, &t->elem);
+  t->ready_tick = timer_ticks();
+  ready_push(t);
   t->status = THREAD_READY;
+  if (intr_context() && t->priority > running_priority())
+    intr_yield_on_return();
+  intr_set_level(old_level);
+}
+
+/* Yields the CPU if a ready thread has a higher priority than
+   the running thread.  Within an interrupt handler, the yield
+   happens on return from the handler. */
+void thread_preempt(void) {
+  enum intr_level old_level = intr_disable();
+
+  if (ready_max_priority() > running_priority()) {
+    if (intr_context())
+      intr_yield_on_return();
+    else
+      thread_yield();
+  }
   intr_set_level(old_level);
 }
 
@@ -277,8 +447,9 @@ void thread_yield(void) {
   ASSERT(!intr_context());
 
   old_level = intr_disable();
+  cur->ready_tick = timer_ticks();
   if (cur != idle_thread)
-    list_push_back(&ready_list, &cur->elem);
+    ready_push(cur);
   cur->status = THREAD_READY;
   schedule();
   intr_set_level(old_level);
@@ -297,32 +468,145 @@ void thread_foreach(thread_action_func* func, void* aux) {
   }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
-void thread_set_priority(int new_priority) { thread_current()->priority = new_priority; }
+/* Raises T's priority to PRIORITY on behalf of a thread waiting
+   for a lock that T holds, moving T to the matching run queue if
+   it is ready.  The donation lasts until T next calls
+   thread_refresh_priority().  Interrupts must be off. */
+void thread_donate_priority(struct thread* t, int priority) {
+  ASSERT(is_thread(t));
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  ASSERT(!thread_mlfqs);
+
+  if (priority <= t->priority)
+    return;
+  if (t->status == THREAD_READY) {
+    ready_remove(t);
+    t->priority = priority;
+    ready_push(t);
+  } else
+    t->priority = priority;
+}
+
+/* Recomputes the running thread's priority as the higher of its
+   own and the highest priority of any thread waiting for a lock
+   it still holds.  Does not yield.  Does nothing under the
+   MLFQS, which sets priorities itself. */
+void thread_refresh_priority(void) {
+  struct thread* cur = thread_current();
+  struct list_elem *l, *w;
+  enum intr_level old_level;
+  int priority = cur->base_priority;
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable();
+  for (l = list_begin(&cur->held_locks); l != list_end(&cur->held_locks); l = list_next(l)) {
+    struct list* waiters = &list_entry(l, struct lock, elem)->semaphore.waiters;
+    for (w = list_begin(waiters); w != list_end(waiters); w = list_next(w)) {
+      struct thread* t = list_entry(w, struct thread, elem);
+      if (t->priority > priority)
+        priority = t->priority;
+    }
+  }
+  cur->priority = priority;
+  intr_set_level(old_level);
+}
+
+/* Sets the current thread's priority to NEW_PRIORITY, yielding
+   if that leaves a ready thread with a higher priority.  Donated
+   priority stays in effect until the locks it came through are
+   released.  Ignored under the MLFQS. */
+void thread_set_priority(int new_priority) {
+  ASSERT(PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  thread_current()->base_priority = new_priority;
+  thread_refresh_priority();
+  thread_preempt();
+}
 
-/* Returns the current thread's priority. */
+/* Returns the current thread's priority, including donations. */
 int thread_get_priority(void) { return thread_current()->priority; }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED) { /* Not yet implemented. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority, yielding if it no longer has the highest. */
+void thread_set_nice(int nice) {
+  enum intr_level old_level;
+
+  ASSERT(NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable();
+  thread_current()->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority(thread_current(), NULL);
+  intr_set_level(old_level);
+  thread_preempt();
 }
 
 /* Returns the current thread's nice value. */
-int thread_get_nice(void) {
-  /* Not yet implemented. */
-  return 0;
-}
+int thread_get_nice(void) { return thread_current()->nice; }
 
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void) {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable();
+  int load = fix_round(fix_scale(load_avg, 100));
+
+  intr_set_level(old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void) {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable();
+  int recent = fix_round(fix_scale(thread_current()->recent_cpu, 100));
+
+  intr_set_level(old_level);
+  return recent;
+}
+
+/* Returns the MLFQS priority for T, from its recent_cpu and
+   nice:  PRI_MAX - recent_cpu / 4 - nice * 2, clamped to
+   PRI_MIN...PRI_MAX. */
+static int mlfqs_priority(const struct thread* t) {
+  int priority = fix_trunc(fix_sub(fix_int(PRI_MAX - t->nice * 2), fix_unscale(t->recent_cpu, 4)));
+
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  if (priority > PRI_MAX)
+    return PRI_MAX;
+  return priority;
+}
+
+/* Recomputes T's MLFQS priority, moving T to the matching run
+   queue if it is ready.  Does not yield.  Leaves the idle thread
+   alone. */
+static void mlfqs_update_priority(struct thread* t, void* aux UNUSED) {
+  int priority;
+
+  if (t == idle_thread)
+    return;
+  priority = mlfqs_priority(t);
+  if (priority == t->priority)
+    return;
+  if (t->status == THREAD_READY) {
+    ready_remove(t);
+    t->priority = priority;
+    ready_push(t);
+  } else
+    t->priority = priority;
+}
+
+/* Applies the once-a-second decay to T's recent_cpu, where DECAY_
+   points to 2 * load_avg / (2 * load_avg + 1). */
+static void mlfqs_decay_recent_cpu(struct thread* t, void* decay_) {
+  fixed_point_t* decay = decay_;
+
+  if (t != idle_thread)
+    t->recent_cpu = fix_add(fix_mul(*decay, t->recent_cpu), fix_int(t->nice));
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -397,7 +681,20 @@ static void init_thread(struct thread* t, const char* name, int priority) {
   t->status = THREAD_BLOCKED;
   strlcpy(t->name, name, sizeof t->name);
   t->stack = (uint8_t*)t + PGSIZE;
+  /* Under the MLFQS, a new thread starts with its parent's nice
+     and recent_cpu, and its priority follows from those.  The
+     initial thread has no parent and starts from 0 for both.
+     -mlfqs is parsed before thread_init, so this covers it too. */
+  if (thread_mlfqs) {
+    if (t != initial_thread) {
+      t->nice = running_thread()->nice;
+      t->recent_cpu = running_thread()->recent_cpu;
+    }
+    priority = mlfqs_priority(t);
+  }
   t->priority = priority;
+  t->base_priority = priority;
+  list_init(&t->held_locks);
   t->magic = THREAD_MAGIC;
 
   old_level = intr_disable();
@@ -416,16 +713,80 @@ static void* alloc_frame(struct thread* t, size_t size) {
   return t->stack;
 }
 
+/* Adds T to the back of the run queue for its priority. */
+static void ready_push(struct thread* t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  list_push_back(&ready_queues[t->priority], &t->elem);
+  ready_mask |= (uint64_t)1 << t->priority;
+  ready_count++;
+}
+
+/* Removes ready thread T from its run queue. */
+static void ready_remove(struct thread* t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  list_remove(&t->elem);
+  ready_count--;
+  if (list_empty(&ready_queues[t->priority]))
+    ready_mask &= ~((uint64_t)1 << t->priority);
+}
+
+/* Returns the highest priority of any ready thread, or
+   PRI_MIN - 1 if no thread is ready.  The mask is scanned as two
+   32-bit halves, since __builtin_clz() on those is a single bsr
+   instruction on the 80x86. */
+static int ready_max_priority(void) {
+  uint32_t high = ready_mask >> 32;
+  uint32_t low = ready_mask;
+
+  if (high != 0)
+    return 63 - __builtin_clz(high);
+  if (low != 0)
+    return 31 - __builtin_clz(low);
+  return PRI_MIN - 1;
+}
+
+/* Returns the running thread's priority, taking the idle thread
+   to be below every other thread. */
+static int running_priority(void) {
+  struct thread* t = running_thread();
+
+  return t == idle_thread ? PRI_MIN - 1 : t->priority;
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   return the first thread in the highest-priority non-empty run
+   queue, unless every run queue is empty.  (If the running
+   thread can continue running, then it will be in a run queue.)
+   If every run queue is empty, return idle_thread. */
 static struct thread* next_thread_to_run(void) {
-  if (list_empty(&ready_list))
+  int pri = ready_max_priority();
+  struct thread* t;
+
+  if (pri < PRI_MIN)
     return idle_thread;
-  else
-    return list_entry(list_pop_front(&ready_list), struct thread, elem);
+
+  t = list_entry(list_pop_front(&ready_queues[pri]), struct thread, elem);
+  ready_count--;
+  if (list_empty(&ready_queues[pri]))
+    ready_mask &= ~((uint64_t)1 << pri);
+  record_wait(t);
+  return t;
+}
+
+/* Adds the time T spent in the run queues, which ends now, to
+   its statistics and the wait histogram. */
+static void record_wait(struct thread* t) {
+  int64_t wait = timer_ticks() - t->ready_tick;
+  int bucket = 0;
+
+  t->wait_ticks += wait;
+  if (wait > t->max_wait)
+    t->max_wait = wait;
+  while (bucket < WAIT_BUCKETS - 1 && wait >> bucket != 0)
+    bucket++;
+  wait_hist[bucket]++;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -487,8 +848,16 @@ static void schedule(void) {
   ASSERT(cur->status != THREAD_RUNNING);
   ASSERT(is_thread(next));
 
-  if (cur != next)
+  if (cur != next) {
+    if (cur->status == THREAD_READY) {
+      cur->invol_switches++;
+      invol_switches++;
+    } else {
+      cur->vol_switches++;
+      vol_switches++;
+    }
     prev = switch_threads(cur, next);
+  }
   thread_schedule_tail(prev);
 }
 
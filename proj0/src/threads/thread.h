@@ -77,21 +77,39 @@ typedef int tid_t;
    value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
    the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   semaphore wait list (synch.c) or the sleep list
+   (devices/timer.c).  It can be used these ways only because
+   they are mutually exclusive: only a thread in the ready state
+   is on the run queue, whereas only a thread in the blocked
+   state is on a semaphore wait list or the sleep list, and a
+   sleeping thread waits on nothing else. */
 struct thread {
   /* Owned by thread.c. */
   tid_t tid;                 /* Thread identifier. */
   enum thread_status status; /* Thread state. */
   char name[16];             /* Name (for debugging purposes). */
   uint8_t* stack;            /* Saved stack pointer. */
-  int priority;              /* Priority. */
+  int priority;              /* Priority, including donations. */
+  int base_priority;         /* Priority before donations. */
+  int nice;                  /* Niceness, for the MLFQS. */
+  fixed_point_t recent_cpu;  /* Recent CPU time, for the MLFQS. */
   struct list_elem allelem;  /* List element for all threads list. */
 
   /* Shared between thread.c and synch.c. */
-  struct list_elem elem; /* List element. */
+  struct list_elem elem;     /* List element. */
+  struct list held_locks;    /* Locks held, which waiters donate through. */
+  struct lock* waiting_lock; /* Lock being waited for, if any. */
+
+  /* Owned by devices/timer.c. */
+  int64_t wakeup_tick; /* Tick to wake up at, while in timer_sleep(). */
+
+  /* Owned by thread.c, for thread_print_stats(). */
+  int64_t ready_tick;      /* Tick it last became ready. */
+  int64_t wait_ticks;      /* # of timer ticks spent ready, in all. */
+  int64_t max_wait;        /* Most timer ticks spent ready at once. */
+  unsigned run_ticks;      /* # of timer ticks spent running. */
+  unsigned vol_switches;   /* # of switches away because it blocked. */
+  unsigned invol_switches; /* # of switches away while still ready. */
 
 #ifdef USERPROG
   /* Owned by userprog/process.c. */
@@ -118,6 +136,9 @@ tid_t thread_create(const char* name, int priority, thread_func*, void*);
 
 void thread_block(void);
 void thread_unblock(struct thread*);
+void thread_preempt(void);
+void thread_donate_priority(struct thread*, int priority);
+void thread_refresh_priority(void);
 
 struct thread* thread_current(void);
 tid_t thread_tid(void);